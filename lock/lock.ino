@@ -1,21 +1,106 @@
 #include <ArduinoBLE.h>
+#include <hardware/clocks.h>
+#include <hardware/gpio.h>
+#include <hardware/pwm.h>
+#include <pico/time.h>
 
 #define DEBUG_SERIAL
 #define LOCKED_ANGLE 0
 #define UNLOCKED_ANGLE 180
 #define SERVO_PIN 0
 
+// サーボは PWM スライスで 50 Hz のパルスを出し続ける (1 カウント = 1 us)
+const uint32_t SERVO_PERIOD_US = 20000;
+const int SERVO_MIN_US = 500;          // 0 度のパルス幅
+const int SERVO_MAX_US = 2400;         // 180 度のパルス幅
+const float SERVO_MAX_SPEED = 180.0f;  // 動かすときの最大の速さ [度/s]
+const int SERVO_FRAME_MS = 20;         // 角度を更新する間隔 (パルスの周期と同じ)
+const unsigned long BLE_POLL_MS = 1000; // イベントがなければこの間 BLE.poll の中で待つ
+
 const int LED_PIN = 15;
-volatile bool deviceConnected = false;
-int currentAngle = LOCKED_ANGLE;
 
 BLEService servoService("19B10000-E8F2-537E-4F6C-D104768A1214"); // 適当なUUID
 
+// start から target まで duration_ms かけて、加減速 (smoothstep) をつけて動かす
+struct ServoProfile {
+    float start;
+    float target;
+    uint32_t start_ms;
+    uint32_t duration_ms;
+};
+
+volatile float currentAngle = LOCKED_ANGLE;
+ServoProfile profile = {LOCKED_ANGLE, LOCKED_ANGLE, 0, 0};
+repeating_timer_t servoTimer;
+volatile bool servoMoving = false;
+
+uint16_t pulseWidth(float angle) {
+    return (uint16_t)(SERVO_MIN_US + (SERVO_MAX_US - SERVO_MIN_US) * angle / 180.0f + 0.5f);
+}
+
+float profileAngle(const ServoProfile& p, uint32_t now) {
+    uint32_t elapsed = now - p.start_ms;
+    if (elapsed >= p.duration_ms) return p.target;
+    float x = (float)elapsed / p.duration_ms;
+    return p.start + (p.target - p.start) * x * x * (3.0f - 2.0f * x);
+}
+
+// タイマー割り込みで 1 フレームごとにパルス幅を更新する。目標に着いたらタイマーを止める
+bool onServoFrame(repeating_timer_t*) {
+    currentAngle = profileAngle(profile, millis());
+    pwm_set_gpio_level(SERVO_PIN, pulseWidth(currentAngle));
+    servoMoving = (currentAngle != profile.target);
+    return servoMoving;
+}
+
+// 今の角度から target へ動かし始める。動いている途中でもそこから折り返す
+void moveServo(float target) {
+    noInterrupts();
+    float start = currentAngle;
+    // smoothstep の最大の速さは平均の 1.5 倍なので、そこが SERVO_MAX_SPEED になるようにする
+    profile = {start, target, (uint32_t)millis(), (uint32_t)(fabsf(target - start) * 1.5f / SERVO_MAX_SPEED * 1000.0f)};
+    bool start_timer = !servoMoving;
+    servoMoving = true;
+    interrupts();
+
+    if (start_timer) add_repeating_timer_ms(-SERVO_FRAME_MS, onServoFrame, nullptr, &servoTimer);
+}
+
+void setupServo() {
+    gpio_set_function(SERVO_PIN, GPIO_FUNC_PWM);
+    uint slice = pwm_gpio_to_slice_num(SERVO_PIN);
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&config, clock_get_hz(clk_sys) / 1000000.0f);
+    pwm_config_set_wrap(&config, SERVO_PERIOD_US - 1);
+    // pwm_init はレベルを 0 に戻すので、止めたまま初期化してから施錠の角度を設定し、動かし始める
+    pwm_init(slice, &config, false);
+    pwm_set_gpio_level(SERVO_PIN, pulseWidth(currentAngle));
+    pwm_set_enabled(slice, true);
+}
+
+// 接続中は解錠、切断したら施錠する
+void onConnected(BLEDevice central) {
+#ifdef DEBUG_SERIAL
+    Serial.printf("Connected to central: %s\n", central.address().c_str());
+#endif
+    digitalWrite(LED_PIN, HIGH); // 接続中はLED点灯
+    moveServo(UNLOCKED_ANGLE);
+}
+
+void onDisconnected(BLEDevice central) {
+#ifdef DEBUG_SERIAL
+    Serial.printf("Disconnected from central: %s\n", central.address().c_str());
+#endif
+    digitalWrite(LED_PIN, LOW);
+    moveServo(LOCKED_ANGLE);
+}
+
 void setup() {
 #ifdef DEBUG_SERIAL
     Serial.begin(115200);
 #endif
     pinMode(LED_PIN, OUTPUT);
+    setupServo();
 
     if (!BLE.begin()) {
 #ifdef DEBUG_SERIAL
@@ -27,46 +112,12 @@ void setup() {
     BLE.setLocalName("BicycleLocker");
     BLE.setAdvertisedService(servoService);
     BLE.addService(servoService);
+    BLE.setEventHandler(BLEConnected, onConnected);
+    BLE.setEventHandler(BLEDisconnected, onDisconnected);
     BLE.advertise();
 }
 
+// サーボはタイマー割り込みと PWM が動かすので、ここでは BLE のイベントを待つだけ (コア1は使わない)
 void loop() {
-    BLEDevice central = BLE.central();
-
-    if (central) {
-#ifdef DEBUG_SERIAL
-        Serial.printf("Connected to central: %s\n", central.address());
-#endif
-        deviceConnected = true;
-        digitalWrite(LED_PIN, HIGH); // 接続中はLED点灯
-        while (central.connected()) delay(100); //接続中はずっとここでループ
-#ifdef DEBUG_SERIAL
-        Serial.printf("Disconected from central: %s\n", central.address());
-#endif
-        deviceConnected = false;
-        digitalWrite(LED_PIN, LOW);
-    }
-}
-
-void setup1() {
-    pinMode(SERVO_PIN, OUTPUT);
-}
-
-void loop1() {
-    long startMicros = micros();
-    currentAngle = controlAngle(currentAngle, deviceConnected ? UNLOCKED_ANGLE : LOCKED_ANGLE);
-    controlServo(currentAngle, startMicros);
-}
-
-int controlAngle(int angle,int targetAngle) {
-    if (angle == targetAngle) return angle;
-    return (angle - targetAngle > 0) ? angle-- : angle++;
-}
-
-void controlServo(int angle, int startMicros) {
-    long pulseWidth = map(angle, 0, 180, 500, 2400);
-    digitalWrite(SERVO_PIN, HIGH);
-    delayMicroseconds(pulseWidth);
-    digitalWrite(SERVO_PIN, LOW);
-    delayMicroseconds(20000 - (micros() - startMicros));
+    BLE.poll(BLE_POLL_MS);
 }
\ No newline at end of file
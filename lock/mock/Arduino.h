@@ -0,0 +1,43 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+// ホスト (PC) でスケッチを動かすための Arduino API のモック。
+// 時刻はシミュレーションの時刻 (mock.h の mockAdvance で進める)
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+typedef unsigned int uint;
+typedef std::string String;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void noInterrupts();
+void interrupts();
+
+class MockSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void println(const char* s) { printf("# %s\n", s); }
+    template <typename... Args>
+    void printf(const char* format, Args... args) {
+        ::printf("# ");
+        ::printf(format, args...);
+    }
+};
+extern MockSerial Serial;
+
+// スケッチが定義する
+void setup();
+void loop();
+
+#endif // MOCK_ARDUINO_H
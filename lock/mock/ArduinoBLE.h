@@ -0,0 +1,48 @@
+#ifndef MOCK_ARDUINO_BLE_H
+#define MOCK_ARDUINO_BLE_H
+
+// ArduinoBLE のモック。接続・切断は mock.h の mockScheduleConnection で予約し、BLE.poll の中で起こす
+#include "Arduino.h"
+
+enum BLEDeviceEvent { BLEConnected, BLEDisconnected, BLEDeviceLastEvent };
+
+class BLEDevice {
+public:
+    explicit BLEDevice(const String& address = "") : address_(address) {}
+    String address() const { return address_; }
+    bool connected() const;
+    operator bool() const { return !address_.empty(); }
+
+private:
+    String address_;
+};
+
+class BLEService {
+public:
+    explicit BLEService(const char* uuid) : uuid_(uuid) {}
+    const char* uuid() const { return uuid_; }
+
+private:
+    const char* uuid_;
+};
+
+typedef void (*BLEDeviceEventHandler)(BLEDevice device);
+
+class MockBLE {
+public:
+    int begin() { return 1; }
+    void setLocalName(const char* name) { (void)name; }
+    void setAdvertisedService(const BLEService& service) { (void)service; }
+    void addService(BLEService& service) { (void)service; }
+    int advertise() { return 1; }
+    void setEventHandler(BLEDeviceEvent event, BLEDeviceEventHandler handler) { handlers[event] = handler; }
+    BLEDevice central();
+
+    // timeout_ms の間、シミュレーションの時刻を進める (予約した接続・切断が来たらそこで戻る)
+    void poll(unsigned long timeout_ms = 0);
+
+    BLEDeviceEventHandler handlers[BLEDeviceLastEvent] = {nullptr, nullptr};
+};
+extern MockBLE BLE;
+
+#endif // MOCK_ARDUINO_BLE_H
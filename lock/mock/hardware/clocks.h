@@ -0,0 +1,13 @@
+#ifndef MOCK_HARDWARE_CLOCKS_H
+#define MOCK_HARDWARE_CLOCKS_H
+
+#include <stdint.h>
+
+enum clock_index { clk_sys = 5 };
+
+inline uint32_t clock_get_hz(clock_index clk) {
+    (void)clk;
+    return 133000000;
+}
+
+#endif // MOCK_HARDWARE_CLOCKS_H
@@ -0,0 +1,8 @@
+#ifndef MOCK_HARDWARE_GPIO_H
+#define MOCK_HARDWARE_GPIO_H
+
+enum gpio_function { GPIO_FUNC_SIO = 5, GPIO_FUNC_PWM = 4 };
+
+void gpio_set_function(unsigned int gpio, gpio_function fn);
+
+#endif // MOCK_HARDWARE_GPIO_H
@@ -0,0 +1,22 @@
+#ifndef MOCK_HARDWARE_PWM_H
+#define MOCK_HARDWARE_PWM_H
+
+// pico-sdk の PWM のモック。設定とレベルを覚えておき、mock.h の mockPulseWidthUs で読み出す
+#include <stdint.h>
+#include "gpio.h"
+
+typedef struct {
+    float clkdiv;
+    uint32_t wrap;
+} pwm_config;
+
+inline unsigned int pwm_gpio_to_slice_num(unsigned int gpio) { return (gpio >> 1) & 7; }
+inline pwm_config pwm_get_default_config() { return {1.0f, 0xffff}; }
+inline void pwm_config_set_clkdiv(pwm_config* c, float div) { c->clkdiv = div; }
+inline void pwm_config_set_wrap(pwm_config* c, uint16_t wrap) { c->wrap = wrap; }
+
+void pwm_init(unsigned int slice, pwm_config* c, bool start);
+void pwm_set_enabled(unsigned int slice, bool enabled);
+void pwm_set_gpio_level(unsigned int gpio, uint16_t level);
+
+#endif // MOCK_HARDWARE_PWM_H
@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include "Arduino.h"
+#include "mock.h"
+
+// スケッチをホストで動かし、接続・切断に対するサーボのパルス幅の変化を CSV で出す
+//   ./build/lock_host [接続 ms] [切断 ms] ...   (既定: 200 ms に接続、2000 ms に切断)
+// 出力: time_ms,kind,pin,value (pwm はパルス幅 [us]、pin は digitalWrite の値)。
+// '#' で始まる行はスケッチのログと、イベントからパルス幅が止まるまでの時間
+
+const int SERVO_PIN = 0;
+const int LED_PIN = 15;      // 接続中に点灯する (接続・切断の時刻を見るのに使う)
+const uint32_t SETTLE_MS = 3000;   // 最後のイベントからこれだけ動かす
+
+int main(int argc, char** argv) {
+    uint32_t last_ms = 2000;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            last_ms = (uint32_t)atoi(argv[i]);
+            mockScheduleConnection(last_ms, i % 2 == 1);
+        }
+    } else {
+        mockScheduleConnection(200, true);
+        mockScheduleConnection(last_ms, false);
+    }
+
+    printf("time_ms,kind,pin,value\n");
+    mockTrace(true);
+    setup();
+
+    // BLE.poll はイベントが来たらその時刻で戻る。次のイベントまでにパルス幅が止まった時刻を見る
+    uint64_t event_us = 0;
+    int loops = 0;
+    auto report = [&]() {
+        uint64_t changed = mockPulseChangedUs(SERVO_PIN);
+        if (event_us > 0 && changed >= event_us) {
+            printf("# pulse %.0f us, last change %.1f ms after the event at %.1f ms\n", mockPulseWidthUs(SERVO_PIN),
+                   (changed - event_us) / 1000.0, event_us / 1000.0);
+        }
+    };
+    while (mockNowUs() < (uint64_t)(last_ms + SETTLE_MS) * 1000) {
+        int led = mockPinState(LED_PIN);
+        loop();
+        loops++;
+        if (mockPinState(LED_PIN) != led) {
+            report();
+            event_us = mockNowUs();
+        }
+    }
+    report();
+    printf("# loop() calls: %d\n", loops);
+    return 0;
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "Arduino.h"
+#include "ArduinoBLE.h"
+#include "hardware/clocks.h"
+#include "hardware/pwm.h"
+#include "mock.h"
+#include "pico/time.h"
+
+MockSerial Serial;
+MockBLE BLE;
+
+static uint64_t now_us = 0;
+static std::map<int, int> pins;
+static std::map<unsigned int, pwm_config> slices;
+static std::map<unsigned int, uint16_t> levels;
+static std::map<unsigned int, bool> enabled;
+static std::map<unsigned int, uint64_t> level_changed;
+static bool trace = false;
+static std::vector<repeating_timer_t*> timers;
+
+struct ConnectionEvent {
+    uint64_t at_us;
+    bool connected;
+};
+static std::vector<ConnectionEvent> connections;
+static bool connected = false;
+
+uint64_t mockNowUs() { return now_us; }
+
+void mockAdvanceTo(uint64_t until_us) {
+    while (true) {
+        // 次に期限が来るタイマー
+        repeating_timer_t* next = nullptr;
+        for (repeating_timer_t* t : timers) {
+            if (!next || t->next_us < next->next_us) next = t;
+        }
+        if (!next || next->next_us > until_us) break;
+
+        now_us = next->next_us;
+        next->next_us += next->delay_us < 0 ? -next->delay_us : next->delay_us;
+        if (!next->callback(next)) cancel_repeating_timer(next);
+    }
+    now_us = std::max(now_us, until_us);
+}
+
+void mockScheduleConnection(uint32_t at_ms, bool connect) {
+    connections.push_back({(uint64_t)at_ms * 1000, connect});
+    std::sort(connections.begin(), connections.end(),
+              [](const ConnectionEvent& a, const ConnectionEvent& b) { return a.at_us < b.at_us; });
+}
+
+double mockPulseWidthUs(unsigned int gpio) {
+    auto slice = slices.find(pwm_gpio_to_slice_num(gpio));
+    if (slice == slices.end() || !enabled[slice->first]) return 0.0; // 止まっているスライスはパルスを出さない
+    // 1 カウントの長さ = clkdiv / clk_sys
+    return levels[gpio] * (double)slice->second.clkdiv / clock_get_hz(clk_sys) * 1e6;
+}
+
+uint64_t mockPulseChangedUs(unsigned int gpio) { return level_changed[gpio]; }
+
+int mockPinState(int pin) { return pins[pin]; }
+
+void mockTrace(bool enable) { trace = enable; }
+
+// ---- Arduino ----
+
+void pinMode(int pin, int mode) {
+    (void)mode;
+    pins[pin] = LOW;
+}
+
+void digitalWrite(int pin, int value) {
+    if (trace && pins[pin] != value) printf("%.1f,pin,%d,%d\n", now_us / 1000.0, pin, value);
+    pins[pin] = value;
+}
+unsigned long millis() { return (unsigned long)(now_us / 1000); }
+unsigned long micros() { return (unsigned long)now_us; }
+void delay(unsigned long ms) { mockAdvanceTo(now_us + (uint64_t)ms * 1000); }
+void noInterrupts() {}
+void interrupts() {}
+
+// ---- pico-sdk ----
+
+void gpio_set_function(unsigned int gpio, gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+static void tracePulse(unsigned int gpio) {
+    if (trace && slices.count(pwm_gpio_to_slice_num(gpio))) {
+        printf("%.1f,pwm,%u,%.1f\n", now_us / 1000.0, gpio, mockPulseWidthUs(gpio));
+    }
+}
+
+// 実際の SDK と同じく、カウンタと両チャンネルのレベル (CC) を 0 に戻す
+void pwm_init(unsigned int slice, pwm_config* c, bool start) {
+    slices[slice] = *c;
+    enabled[slice] = start;
+    for (auto& level : levels) {
+        if (pwm_gpio_to_slice_num(level.first) != slice) continue;
+        if (level.second != 0) level_changed[level.first] = now_us;
+        level.second = 0;
+        tracePulse(level.first);
+    }
+}
+
+void pwm_set_enabled(unsigned int slice, bool enable) {
+    if (enabled[slice] == enable) return;
+    enabled[slice] = enable;
+    for (const auto& level : levels) {
+        if (pwm_gpio_to_slice_num(level.first) == slice) tracePulse(level.first);
+    }
+}
+
+void pwm_set_gpio_level(unsigned int gpio, uint16_t level) {
+    if (levels.count(gpio) && levels[gpio] == level) return;
+    levels[gpio] = level;
+    level_changed[gpio] = now_us;
+    tracePulse(gpio);
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out) {
+    out->delay_us = (int64_t)delay_ms * 1000;
+    out->next_us = now_us + (delay_ms < 0 ? -out->delay_us : out->delay_us);
+    out->callback = callback;
+    out->user_data = user_data;
+    cancel_repeating_timer(out);
+    timers.push_back(out);
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t* timer) {
+    auto it = std::find(timers.begin(), timers.end(), timer);
+    if (it == timers.end()) return false;
+    timers.erase(it);
+    return true;
+}
+
+// ---- ArduinoBLE ----
+
+static const char* CENTRAL_ADDRESS = "00:11:22:33:44:55";
+
+bool BLEDevice::connected() const { return ::connected; }
+
+BLEDevice MockBLE::central() { return BLEDevice(::connected ? CENTRAL_ADDRESS : ""); }
+
+void MockBLE::poll(unsigned long timeout_ms) {
+    uint64_t deadline = now_us + (uint64_t)timeout_ms * 1000;
+    if (connections.empty() || connections.front().at_us > deadline) {
+        mockAdvanceTo(deadline);
+        return;
+    }
+
+    ConnectionEvent event = connections.front();
+    connections.erase(connections.begin());
+    mockAdvanceTo(event.at_us);
+    if (event.connected == ::connected) return;
+    ::connected = event.connected;
+    BLEDeviceEventHandler handler = handlers[event.connected ? BLEConnected : BLEDisconnected];
+    if (handler) handler(BLEDevice(CENTRAL_ADDRESS));
+}
@@ -0,0 +1,24 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+// モックを動かすシミュレーション側の API (main.cpp から使う)
+#include <stdint.h>
+
+// シミュレーションの時刻 [us]
+uint64_t mockNowUs();
+
+// 時刻を until_us まで進める。途中で期限の来たタイマーを呼び出す
+void mockAdvanceTo(uint64_t until_us);
+
+// at_ms に接続 (connected = true) または切断する
+void mockScheduleConnection(uint32_t at_ms, bool connected);
+
+// 最後に設定したパルス幅 [us] (PWM の設定から換算する) と、それが変わった時刻 [us]
+double mockPulseWidthUs(unsigned int gpio);
+uint64_t mockPulseChangedUs(unsigned int gpio);
+int mockPinState(int pin);
+
+// ピンと PWM の変化を CSV (time_ms,kind,pin,value) で標準出力に書く
+void mockTrace(bool enable);
+
+#endif // MOCK_H
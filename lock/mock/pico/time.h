@@ -0,0 +1,20 @@
+#ifndef MOCK_PICO_TIME_H
+#define MOCK_PICO_TIME_H
+
+// pico-sdk の repeating timer のモック。シミュレーションの時刻が進むときに呼び出す
+#include <stdint.h>
+
+struct repeating_timer;
+typedef bool (*repeating_timer_callback_t)(repeating_timer* t);
+
+typedef struct repeating_timer {
+    int64_t delay_us;
+    uint64_t next_us;
+    repeating_timer_callback_t callback;
+    void* user_data;
+} repeating_timer_t;
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void* user_data, repeating_timer_t* out);
+bool cancel_repeating_timer(repeating_timer_t* timer);
+
+#endif // MOCK_PICO_TIME_H
@@ -1,30 +1,117 @@
 // 追加のボードマネージャ(https://github.com/earlephilhower/arduino-pico/releases/download/global/package_rp2040_index.json)
+#include <hardware/adc.h>
+#include <hardware/dma.h>
+
 #define AnalogPin 27
-#define TEST_DEBUG // テスト用
-int batteryVoltage = 0, batteryLevel = 0;
-void setup() {
-    pinMode(AnalogPin, INPUT);
+#define ADC_INPUT 1 // GPIO27 = ADC1
+
+// ADC は自身のクロック分周で一定間隔に変換し続け、DMA がリングバッファに書き込む (CPU は触らない)。
+// loop() は FILTER_INTERVAL_MS ごとに溜まったサンプルを平均 (オーバーサンプリング) してローパスに入れる。
+//
+// シリアルのコマンド:
+//   s        問い合わせ。"b:<mV>::" を返す
+//   r<hz>;   "v:<ms>:<mV>:<%>" を <hz> で送り続ける (0 で止める。起動直後は止まっている)
+const uint32_t ADC_CLOCK_HZ = 48000000;
+const uint32_t ADC_SAMPLE_HZ = 2000;
+const int RING_BITS = 9; // リングバッファ 2^9 バイト = 256 サンプル (128 ms 分)
+const uint32_t RING_SAMPLES = (1 << RING_BITS) / sizeof(uint16_t);
+const uint32_t DMA_TRANSFER_COUNT = 0xffffffff; // 2 kHz で約 24 日。終わったら loop() で再開する
+const unsigned long FILTER_INTERVAL_MS = 10;
+const float FILTER_ALPHA = 0.1f;     // 1 次ローパス (時定数 約 100 ms)
+const float ADC_REF_MV = 3300.0f;
+const float DIVIDER_RATIO = 1.0f;    // 電池の電圧 / AnalogPin の電圧 (分圧抵抗に合わせる)
+const int BATTERY_EMPTY_MV = 2800;   // 0 %
+const int BATTERY_FULL_MV = 3300;    // 100 %
+const unsigned long MAX_PUSH_HZ = 100;
+
+uint16_t samples[RING_SAMPLES] __attribute__((aligned(1 << RING_BITS)));
+int dmaChannel;
+uint32_t samplesRead = 0;      // DMA が書いたサンプルのうち、フィルタに入れた数
+float batteryMv = -1.0f;       // フィルタ後の電圧 (まだサンプルがなければ負)
+unsigned long lastFilterMs = 0, lastPushMs = 0, pushIntervalMs = 0;
+char command[16];
+int commandLength = 0;
+
+void startDma() {
+    dma_channel_config config = dma_channel_get_default_config(dmaChannel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, RING_BITS);
+    channel_config_set_dreq(&config, DREQ_ADC);
+    dma_channel_configure(dmaChannel, &config, samples, &adc_hw->fifo, DMA_TRANSFER_COUNT, true);
+    samplesRead = 0;
 }
-void setup1() {
-    Serial.begin(115200);
+
+// 前回から DMA が書いたサンプルを平均してローパスに入れる
+void updateFilter() {
+    uint32_t written = DMA_TRANSFER_COUNT - dma_channel_hw_addr(dmaChannel)->transfer_count;
+    if (written - samplesRead > RING_SAMPLES) samplesRead = written - RING_SAMPLES; // 追い越された分は捨てる
+    uint32_t n = written - samplesRead;
+    if (n == 0) return;
+
+    uint32_t sum = 0;
+    for (; samplesRead != written; samplesRead++) sum += samples[samplesRead % RING_SAMPLES];
+    float mv = (float)sum / n * ADC_REF_MV / 4095.0f * DIVIDER_RATIO;
+    batteryMv = (batteryMv < 0) ? mv : batteryMv + FILTER_ALPHA * (mv - batteryMv);
 }
 
-void loop() {
-    if(Serial.available() > 0) {
-        char command = Serial.read();
-        if(command == 's') {
-            Serial.printf("b:%d::\n", batteryLevel);
+int batteryPercent() {
+    int percent = (int)((batteryMv - BATTERY_EMPTY_MV) * 100.0f / (BATTERY_FULL_MV - BATTERY_EMPTY_MV));
+    return constrain(percent, 0, 100);
+}
+
+void readCommands() {
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == 's' && commandLength == 0) {
+            Serial.printf("b:%d::\n", (int)max(batteryMv, 0.0f));
+        } else if (c == 'r' && commandLength == 0) {
+            command[commandLength++] = c;
+        } else if (c == ';' && commandLength > 0) {
+            command[commandLength] = 0;
+            unsigned long hz = min((unsigned long)atol(command + 1), MAX_PUSH_HZ);
+            pushIntervalMs = hz > 0 ? 1000 / hz : 0;
+            lastPushMs = millis();
+            commandLength = 0;
+        } else if (commandLength > 0 && commandLength < (int)sizeof(command) - 1) {
+            command[commandLength++] = c;
+        } else {
+            commandLength = 0; // 解釈できないものは捨てる
         }
     }
-    delay(1);
 }
 
-void loop1() {
-    #ifndef TEST_DEBUG
-    batteryVoltage = analogRead(AnalogPin);
-    batteryLevel = map(batteryVoltage, 0, 4095, 0, 3300);
-    #endif
-    #ifdef TEST_DEBUG
-    batteryLevel = random(0, 4095);
-    #endif
+void setup() {
+    Serial.begin(115200);
+
+    adc_init();
+    adc_gpio_init(AnalogPin);
+    adc_select_input(ADC_INPUT);
+    adc_fifo_setup(true, true, 1, false, false); // 1 サンプルごとに DREQ
+    adc_set_clkdiv(ADC_CLOCK_HZ / ADC_SAMPLE_HZ - 1);
+
+    dmaChannel = dma_claim_unused_channel(true);
+    startDma();
+    adc_run(true);
+}
+
+// コア1は使わない。サンプリングは ADC と DMA が行うので、ここは 1 ms ごとに起きるだけ
+void loop() {
+    unsigned long now = millis();
+    if (now - lastFilterMs >= FILTER_INTERVAL_MS) {
+        lastFilterMs = now;
+        if (!dma_channel_is_busy(dmaChannel)) startDma();
+        updateFilter();
+    }
+
+    readCommands();
+
+    if (pushIntervalMs > 0 && now - lastPushMs >= pushIntervalMs && batteryMv >= 0) {
+        // 遅れても追いつこうとして続けて送らない
+        lastPushMs = (now - lastPushMs < 2 * pushIntervalMs) ? lastPushMs + pushIntervalMs : now;
+        Serial.printf("v:%lu:%d:%d\n", now, (int)batteryMv, batteryPercent());
+    }
+
+    delay(1);
 }
@@ -0,0 +1,40 @@
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+// ホスト (PC) でスケッチを動かすための Arduino API のモック。
+// 時刻はシミュレーションの時刻で、delay() で進む (その間に ADC と DMA が動く)
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+unsigned long millis();
+void delay(unsigned long ms);
+
+class MockSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available();
+    int read();
+    template <typename... Args>
+    void printf(const char* format, Args... args) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), format, args...);
+        write(buf);
+    }
+    void write(const char* s);
+};
+extern MockSerial Serial;
+
+// スケッチが定義する
+void setup();
+void loop();
+
+#endif // MOCK_ARDUINO_H
@@ -0,0 +1,19 @@
+#ifndef MOCK_HARDWARE_ADC_H
+#define MOCK_HARDWARE_ADC_H
+
+// pico-sdk の ADC のモック。adc_run(true) の後、分周から決まる間隔でサンプルを FIFO (DMA) に送る
+#include <stdint.h>
+
+typedef struct {
+    uint32_t fifo;
+} adc_hw_t;
+extern adc_hw_t* const adc_hw;
+
+void adc_init();
+void adc_gpio_init(unsigned int gpio);
+void adc_select_input(unsigned int input);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+
+#endif // MOCK_HARDWARE_ADC_H
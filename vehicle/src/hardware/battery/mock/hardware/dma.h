@@ -0,0 +1,38 @@
+#ifndef MOCK_HARDWARE_DMA_H
+#define MOCK_HARDWARE_DMA_H
+
+// pico-sdk の DMA のモック。ADC の DREQ で 1 サンプルずつ、リングの範囲で書き込む
+#include <stdint.h>
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+enum { DREQ_ADC = 36 };
+
+typedef struct {
+    dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    bool ring_write;
+    unsigned int ring_bits;
+    unsigned int dreq;
+} dma_channel_config;
+
+typedef struct {
+    volatile uint32_t transfer_count;   // 残りの転送数
+} dma_channel_hw_t;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(unsigned int channel);
+inline void channel_config_set_transfer_data_size(dma_channel_config* c, dma_channel_transfer_size size) { c->size = size; }
+inline void channel_config_set_read_increment(dma_channel_config* c, bool incr) { c->read_increment = incr; }
+inline void channel_config_set_write_increment(dma_channel_config* c, bool incr) { c->write_increment = incr; }
+inline void channel_config_set_ring(dma_channel_config* c, bool write, unsigned int size_bits) {
+    c->ring_write = write;
+    c->ring_bits = size_bits;
+}
+inline void channel_config_set_dreq(dma_channel_config* c, unsigned int dreq) { c->dreq = dreq; }
+void dma_channel_configure(unsigned int channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint32_t transfer_count, bool trigger);
+dma_channel_hw_t* dma_channel_hw_addr(unsigned int channel);
+bool dma_channel_is_busy(unsigned int channel);
+
+#endif // MOCK_HARDWARE_DMA_H
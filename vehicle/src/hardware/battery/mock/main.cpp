@@ -0,0 +1,55 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include "Arduino.h"
+#include "mock.h"
+
+// スケッチをホストで動かし、シリアルに出した行を CSV で出す
+//   ./build/battery_host [送る周期 Hz] [時間 ms] [ノイズ mV]   (既定: 10 Hz, 5000 ms, 30 mV)
+// AnalogPin の電圧は 3200 mV から 1 秒に 20 mV ずつ下がるとする。
+// 出力: time_ms,true_mv,line。'#' で始まる行は、送った電圧と実際の電圧の差の集計
+
+static double drainingBattery(double t) { return 3200.0 - 20.0 * t; }
+
+int main(int argc, char** argv) {
+    int push_hz = argc > 1 ? atoi(argv[1]) : 10;
+    uint32_t duration_ms = argc > 2 ? (uint32_t)atoi(argv[2]) : 5000;
+    double noise_mv = argc > 3 ? atof(argv[3]) : 30.0;
+
+    mockSetVoltage(drainingBattery, noise_mv);
+    mockScheduleInput(100, "r" + std::to_string(push_hz) + ";");
+    mockScheduleInput(duration_ms / 2, "s");
+
+    setup();
+    printf("time_ms,true_mv,line\n");
+
+    int loops = 0, frames = 0;
+    double sum = 0.0, sum2 = 0.0;
+    while (mockNowUs() < (uint64_t)duration_ms * 1000) {
+        loop();
+        loops++;
+
+        std::string line;
+        uint64_t at_us;
+        while (mockTakeOutput(line, at_us)) {
+            double truth = drainingBattery(at_us * 1e-6);
+            printf("%.1f,%.0f,%s\n", at_us / 1000.0, truth, line.c_str());
+            unsigned long ms;
+            int mv, percent;
+            // 立ち上がり (フィルタが落ち着くまで) は集計しない
+            if (sscanf(line.c_str(), "v:%lu:%d:%d", &ms, &mv, &percent) == 3 && at_us > 1000000) {
+                sum += mv - truth;
+                sum2 += (mv - truth) * (mv - truth);
+                frames++;
+            }
+        }
+    }
+
+    if (frames > 0) {
+        double mean = sum / frames;
+        printf("# frames: %d, error mean %.1f mV, sd %.1f mV (sample noise %.1f mV)\n", frames, mean,
+               sqrt(std::max(0.0, sum2 / frames - mean * mean)), noise_mv);
+    }
+    printf("# ADC samples: %llu, loop() calls: %d\n", (unsigned long long)mockAdcSamples(), loops);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include <deque>
+#include <random>
+#include "Arduino.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "mock.h"
+
+MockSerial Serial;
+
+static uint64_t now_us = 0;
+
+// ---- ADC ----
+
+static const double ADC_CLOCK_HZ = 48000000.0;
+static adc_hw_t adc_regs;
+adc_hw_t* const adc_hw = &adc_regs;
+static bool adc_running = false;
+static bool adc_dreq = false;
+static double adc_clkdiv = 0.0;
+static uint64_t adc_next_ps = 0;   // 次の変換の時刻 [ps] (分周の端数を落とさないように)
+static uint64_t adc_samples = 0;
+static double (*voltage_source)(double t) = nullptr;
+static double voltage_noise = 0.0;
+static std::mt19937 rng(1);
+
+// ---- DMA ----
+
+struct MockDmaChannel {
+    dma_channel_config config;
+    dma_channel_hw_t hw;
+    uint8_t* base;      // リングの先頭
+    uint32_t offset;    // 次に書く位置 (base からのバイト数)
+    bool busy;
+};
+static MockDmaChannel dma_channels[12];
+static int dma_claimed = 0;
+
+// ADC の 1 サンプルを DREQ を出している DMA に渡す
+static void adcConvert() {
+    double mv = voltage_source ? voltage_source(now_us * 1e-6) : 0.0;
+    mv += std::normal_distribution<double>(0.0, voltage_noise)(rng);
+    long code = lround(mv / 3300.0 * 4095.0);
+    adc_hw->fifo = (uint32_t)constrain(code, 0L, 4095L);
+    adc_samples++;
+    if (!adc_dreq) return;
+
+    for (int i = 0; i < dma_claimed; i++) {
+        MockDmaChannel& ch = dma_channels[i];
+        if (!ch.busy || ch.config.dreq != DREQ_ADC) continue;
+        uint32_t bytes = 1u << ch.config.size;
+        uint32_t ring = ch.config.ring_write ? (1u << ch.config.ring_bits) : 0xffffffffu;
+        if (bytes == 2) *(uint16_t*)(ch.base + ch.offset) = (uint16_t)adc_hw->fifo;
+        if (ch.config.write_increment) ch.offset = (ch.offset + bytes) % ring;
+        if (--ch.hw.transfer_count == 0) ch.busy = false;
+    }
+}
+
+static void advanceTo(uint64_t until_us) {
+    if (adc_running) {
+        uint64_t period_ps = (uint64_t)((adc_clkdiv + 1.0) / ADC_CLOCK_HZ * 1e12);
+        while (adc_next_ps <= until_us * 1000000) {
+            now_us = adc_next_ps / 1000000;
+            adcConvert();
+            adc_next_ps += period_ps;
+        }
+    }
+    now_us = until_us;
+}
+
+uint64_t mockNowUs() { return now_us; }
+
+void mockSetVoltage(double (*voltage)(double t), double noise_mv) {
+    voltage_source = voltage;
+    voltage_noise = noise_mv;
+}
+
+uint64_t mockAdcSamples() { return adc_samples; }
+
+void adc_init() {}
+void adc_gpio_init(unsigned int gpio) { (void)gpio; }
+void adc_select_input(unsigned int input) { (void)input; }
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    (void)en;
+    (void)dreq_thresh;
+    (void)err_in_fifo;
+    (void)byte_shift;
+    adc_dreq = dreq_en;
+}
+
+void adc_set_clkdiv(float clkdiv) { adc_clkdiv = clkdiv; }
+
+void adc_run(bool run) {
+    if (run && !adc_running) adc_next_ps = now_us * 1000000;
+    adc_running = run;
+}
+
+int dma_claim_unused_channel(bool required) {
+    (void)required;
+    return dma_claimed < 12 ? dma_claimed++ : -1;
+}
+
+dma_channel_config dma_channel_get_default_config(unsigned int channel) {
+    (void)channel;
+    return {DMA_SIZE_32, true, false, false, 0, 0x3f};
+}
+
+void dma_channel_configure(unsigned int channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint32_t transfer_count, bool trigger) {
+    (void)read_addr;
+    MockDmaChannel& ch = dma_channels[channel];
+    ch.config = *config;
+    ch.base = (uint8_t*)write_addr;
+    ch.offset = 0;
+    ch.hw.transfer_count = transfer_count;
+    ch.busy = trigger && transfer_count > 0;
+}
+
+dma_channel_hw_t* dma_channel_hw_addr(unsigned int channel) { return &dma_channels[channel].hw; }
+bool dma_channel_is_busy(unsigned int channel) { return dma_channels[channel].busy; }
+
+// ---- Arduino ----
+
+struct ScheduledInput {
+    uint64_t at_us;
+    std::string data;
+};
+static std::deque<ScheduledInput> inputs;
+static std::string rx;
+static std::string tx;
+static std::deque<std::pair<std::string, uint64_t>> lines;
+
+unsigned long millis() { return (unsigned long)(now_us / 1000); }
+void delay(unsigned long ms) { advanceTo(now_us + (uint64_t)ms * 1000); }
+
+void mockScheduleInput(uint32_t at_ms, const std::string& data) {
+    inputs.push_back({(uint64_t)at_ms * 1000, data});
+}
+
+bool mockTakeOutput(std::string& line, uint64_t& at_us) {
+    if (lines.empty()) return false;
+    line = lines.front().first;
+    at_us = lines.front().second;
+    lines.pop_front();
+    return true;
+}
+
+int MockSerial::available() {
+    while (!inputs.empty() && inputs.front().at_us <= now_us) {
+        rx += inputs.front().data;
+        inputs.pop_front();
+    }
+    return (int)rx.size();
+}
+
+int MockSerial::read() {
+    if (available() == 0) return -1;
+    int c = (unsigned char)rx[0];
+    rx.erase(0, 1);
+    return c;
+}
+
+void MockSerial::write(const char* s) {
+    tx += s;
+    size_t end;
+    while ((end = tx.find('\n')) != std::string::npos) {
+        lines.push_back({tx.substr(0, end), now_us});
+        tx.erase(0, end + 1);
+    }
+}
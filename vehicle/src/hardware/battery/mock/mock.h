@@ -0,0 +1,23 @@
+#ifndef MOCK_H
+#define MOCK_H
+
+// モックを動かすシミュレーション側の API (main.cpp から使う)
+#include <stdint.h>
+#include <string>
+
+// シミュレーションの時刻 [us]
+uint64_t mockNowUs();
+
+// AnalogPin の電圧 [mV] (時刻 [s] の関数) と、サンプルごとに足すノイズの標準偏差 [mV]
+void mockSetVoltage(double (*voltage)(double t), double noise_mv);
+
+// at_ms にシリアルで data を受け取る
+void mockScheduleInput(uint32_t at_ms, const std::string& data);
+
+// スケッチがシリアルに書いた行を 1 行取り出す (なければ false)。at_us は書いた時刻
+bool mockTakeOutput(std::string& line, uint64_t& at_us);
+
+// ADC が変換したサンプルの数
+uint64_t mockAdcSamples();
+
+#endif // MOCK_H
@@ -0,0 +1,299 @@
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <benchmark/benchmark.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "../include/human_detector.h"
+#include "../include/human_pose.h"
+#include "../include/human_tracker.h"
+#include "../include/marker_pose.h"
+#include "../include/mjpeg_decoder.h"
+#include "../include/pose_input.h"
+
+// 検出ループのホットパスのマイクロベンチマーク
+//   make bench                       結果は $(BUILD_DIR)/bench.json
+//   compare.py (Google Benchmark付属) で2つの JSON を比較できる
+//
+// allocs/op は1回あたりのヒープ確保回数。OpenCV の Mat は operator new ではなく
+// posix_memalign で確保するので、malloc 系の関数ごと数える。
+
+static std::atomic<uint64_t> g_allocations{0};
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    *p = __libc_memalign(alignment, size);
+    return *p ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+}
+
+// 計測区間のヒープ確保回数を allocs/op として報告する
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State& state)
+        : state(state), start(g_allocations.load(std::memory_order_relaxed)) {}
+
+    ~AllocationCounter() {
+        state.counters["allocs/op"] = benchmark::Counter(
+            (double)(g_allocations.load(std::memory_order_relaxed) - start), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& state;
+    uint64_t start;
+};
+
+// ---- 合成データ ----
+
+// size x size のヒートマップに peaks 個のガウス状の山を置く
+static cv::Mat makeHeatmap(int size, int peaks) {
+    cv::Mat heatMap(size, size, CV_32F, cv::Scalar(0));
+    std::mt19937 rng(size * 1000 + peaks);
+    std::uniform_int_distribution<int> pos(2, size - 3);
+
+    for (int k = 0; k < peaks; k++) {
+        int cx = pos(rng), cy = pos(rng);
+        for (int y = std::max(0, cy - 3); y <= std::min(size - 1, cy + 3); y++) {
+            float* row = heatMap.ptr<float>(y);
+            for (int x = std::max(0, cx - 3); x <= std::min(size - 1, cx + 3); x++) {
+                float d2 = (float)((x - cx) * (x - cx) + (y - cy) * (y - cy));
+                row[x] = std::max(row[x], 0.8f * std::exp(-d2 / 2.0f));
+            }
+        }
+    }
+    return heatMap;
+}
+
+const cv::Size FRAME_SIZE(640, 480);
+
+// people 人が横に並んでいる場合のキーポイント
+static PosePeaks makePeople(int people) {
+    PosePeaks allPeaks(POSE_PARTS);
+    for (int i = 0; i < people; i++) {
+        float x = 20 + (i * 600.0f) / std::max(1, people);
+        float y = 200 + (i % 3) * 20;
+        allPeaks[NOSE].push_back(cv::Point2f(x + 10, y - 60));
+        allPeaks[NECK].push_back(cv::Point2f(x + 10, y - 10));
+        allPeaks[RIGHT_SHOULDER].push_back(cv::Point2f(x, y));
+        allPeaks[LEFT_SHOULDER].push_back(cv::Point2f(x + 25, y));
+        allPeaks[RIGHT_ELBOW].push_back(cv::Point2f(x - 5, y + 50));
+        allPeaks[LEFT_ELBOW].push_back(cv::Point2f(x + 30, y + 50));
+        allPeaks[RIGHT_WRIST].push_back(cv::Point2f(x - 5, y + 100));
+        allPeaks[LEFT_WRIST].push_back(cv::Point2f(x + 30, y + 100));
+    }
+    return allPeaks;
+}
+
+static std::vector<HumanPoseData> makeDetections(int people, int frame) {
+    std::vector<HumanPoseData> detections;
+    for (int i = 0; i < people; i++) {
+        HumanPoseData h{};
+        h.detected = true;
+        double x = 20 + (i * 600.0) / people + (frame % 5);
+        h.right_shoulder[0] = x;
+        h.right_shoulder[1] = 200;
+        h.left_shoulder[0] = x + 10;
+        h.left_shoulder[1] = 200;
+        detections.push_back(h);
+    }
+    return detections;
+}
+
+// ---- ベンチマーク ----
+
+// findPeaks: args = {ヒートマップの一辺, 山の数}
+static void BM_FindPeaks(benchmark::State& state) {
+    cv::Mat heatMap = makeHeatmap(state.range(0), state.range(1));
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        std::vector<cv::Point> peaks = findPeaks(heatMap, PEAK_THRESHOLD);
+        benchmark::DoNotOptimize(peaks.data());
+    }
+    state.SetItemsProcessed(state.iterations() * heatMap.rows * heatMap.cols);
+}
+BENCHMARK(BM_FindPeaks)->ArgsProduct({{46, 92, 184}, {1, 10, 50}});
+
+// サブピクセル化: args = {ヒートマップの一辺, 山の数}
+static void BM_RefinePeaks(benchmark::State& state) {
+    cv::Mat heatMap = makeHeatmap(state.range(0), state.range(1));
+    std::vector<cv::Point> peaks = findPeaks(heatMap, PEAK_THRESHOLD);
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        for (const auto& p : peaks) {
+            cv::Point2f q = refinePeak(heatMap, p);
+            benchmark::DoNotOptimize(q);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * peaks.size());
+}
+BENCHMARK(BM_RefinePeaks)->ArgsProduct({{46}, {1, 10, 50}});
+
+// 肩の検証とペアリング: arg = 人数
+static void BM_GroupHumans(benchmark::State& state) {
+    PosePeaks allPeaks = makePeople(state.range(0));
+    std::vector<HumanPoseData> detectedHumans;
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        groupHumans(allPeaks, FRAME_SIZE, detectedHumans);
+        benchmark::DoNotOptimize(detectedHumans.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GroupHumans)->Arg(1)->Arg(5)->Arg(10)->Arg(20)->Arg(50);
+
+// HumanTracker::update + getResult: arg = 人数
+static void BM_TrackerUpdate(benchmark::State& state) {
+    int people = state.range(0);
+    std::vector<std::vector<HumanPoseData>> frames;
+    for (int f = 0; f < 5; f++) frames.push_back(makeDetections(people, f));
+
+    // ロックがかかった定常状態から測る
+    HumanTracker tracker;
+    for (int f = 0; f < 10; f++) tracker.update(frames[f % frames.size()]);
+
+    size_t f = 0;
+    std::vector<HumanPoseData> result;
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        tracker.update(frames[f++ % frames.size()]);
+        tracker.getResult(result);
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetItemsProcessed(state.iterations() * people);
+}
+BENCHMARK(BM_TrackerUpdate)->Arg(1)->Arg(5)->Arg(10)->Arg(20)->Arg(50);
+
+// blobFromImage による前処理 (640x480 -> 368x368)
+static void BM_BlobFromImage(benchmark::State& state) {
+    cv::Mat frame(FRAME_SIZE.height, FRAME_SIZE.width, CV_8UC3, cv::Scalar(90, 120, 150));
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        cv::Mat inputBlob = cv::dnn::blobFromImage(frame, 1.0, cv::Size(368, 368), cv::Scalar(127.5, 127.5, 127.5), true, false);
+        benchmark::DoNotOptimize(inputBlob.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (int64_t)frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_BlobFromImage);
+
+// PoseInput によるレターボックス前処理 (640x480 -> 368x368, 確保済みテンソルへ書き込む)
+static void BM_PoseInput(benchmark::State& state) {
+    cv::Mat frame(FRAME_SIZE.height, FRAME_SIZE.width, CV_8UC3, cv::Scalar(90, 120, 150));
+    PoseInput poseInput;
+    poseInput.set(frame);
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        poseInput.set(frame);
+        benchmark::DoNotOptimize(poseInput.blob().data);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * (int64_t)frame.total() * frame.elemSize());
+}
+BENCHMARK(BM_PoseInput);
+
+// マーカーの姿勢推定: args = {マーカーの数, 前のフレームの姿勢から合わせ込むか}
+static void BM_MarkerPose(benchmark::State& state) {
+    int markers = state.range(0);
+    bool warm = state.range(1) != 0;
+    cv::Mat camera_matrix = (cv::Mat_<double>(3, 3) << 600, 0, 320, 0, 600, 240, 0, 0, 1);
+
+    // 正面から少し傾けて見たマーカーを横に並べる
+    std::vector<std::vector<cv::Point2f>> corners;
+    std::vector<int> ids;
+    for (int i = 0; i < markers; i++) {
+        float x = 20 + (i % 10) * 60.0f, y = 40 + (i / 10) * 80.0f;
+        corners.push_back({cv::Point2f(x, y), cv::Point2f(x + 40, y + 3), cv::Point2f(x + 41, y + 42), cv::Point2f(x - 1, y + 39)});
+        ids.push_back(i);
+    }
+
+    MarkerPoseEstimator estimator(MARKER_LENGTH);
+    std::vector<cv::Vec3d> rvecs, tvecs;
+    double t = 0.0;
+    for (auto _ : state) {
+        // 合わせ込まない場合は、毎回初期値が古くなるように時刻を飛ばす
+        t += warm ? 0.033 : 1.0;
+        estimator.estimate(corners, ids, camera_matrix, t, rvecs, tvecs);
+        benchmark::DoNotOptimize(tvecs.data());
+    }
+    state.SetItemsProcessed(state.iterations() * markers);
+}
+BENCHMARK(BM_MarkerPose)->ArgsProduct({{1, 10, 50}, {0, 1}});
+
+// MJPEG のデコード: arg = 0 ならフルサイズ、1 ならネットワークの入力 (368x368) を覆う大きさまで縮小デコード
+static void BM_MjpegDecode(benchmark::State& state) {
+    cv::Mat frame(720, 1280, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    std::vector<unsigned char> buf;
+    cv::imencode(".jpg", frame, buf);
+    cv::Mat jpeg(1, (int)buf.size(), CV_8UC1, buf.data());
+
+    MjpegDecoder decoder;
+    cv::Mat bgr;
+    bool scaled = state.range(0) != 0;
+    AllocationCounter allocs(state);
+    for (auto _ : state) {
+        bool ok = scaled ? decoder.decodeScaled(jpeg, cv::Size(368, 368), bgr) : decoder.decodeFull(jpeg, bgr);
+        benchmark::DoNotOptimize(ok);
+        benchmark::DoNotOptimize(bgr.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::to_string(bgr.cols) + "x" + std::to_string(bgr.rows));
+}
+BENCHMARK(BM_MjpegDecode)->Arg(0)->Arg(1);
+
+// 共有メモリへの書き込み: arg = 人数
+static void BM_PublishHumans(benchmark::State& state) {
+    void* p = mmap(nullptr, sizeof(SharedMemoryData), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        state.SkipWithError("mmap failed");
+        return;
+    }
+    SharedMemoryData* shared_data = static_cast<SharedMemoryData*>(p);
+    HumanSection section = humanSection(shared_data, HUMAN_CAMERA_L);
+    std::vector<HumanPoseData> humans = makeDetections(state.range(0), 0);
+
+    double t = 0.0;
+    {
+        AllocationCounter allocs(state);
+        for (auto _ : state) {
+            publishHumans(section, humans, t, t);
+            t += 1e-3;
+            benchmark::ClobberMemory();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    munmap(p, sizeof(SharedMemoryData));
+}
+BENCHMARK(BM_PublishHumans)->Arg(1)->Arg(10);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,37 @@
+#ifndef CAMERA_CALIBRATION_H
+#define CAMERA_CALIBRATION_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "shm_data.h"
+
+// カメラの内部パラメータ (calibrate_camera で作る YAML ファイル)
+//   camera_matrix: 3x3, distortion_coefficients: 1x5 (k1 k2 p1 p2 k3), image_width, image_height
+struct CameraIntrinsics {
+    cv::Mat camera_matrix;
+    cv::Mat dist_coeffs;
+    cv::Size image_size;
+    bool calibrated = false;    // false なら下の既定値 (歪みなし) のまま
+
+    // 歪み補正した点を渡すときに使う (歪み係数ゼロ)
+    cv::Mat zero_dist;
+};
+
+// キャリブレーションしていないときの値 (fx = fy = 600、中心は画像の中央、歪みなし)
+CameraIntrinsics defaultIntrinsics(cv::Size imageSize = cv::Size(640, 480));
+
+bool loadIntrinsics(const std::string& path, CameraIntrinsics& intrinsics);
+bool saveIntrinsics(const std::string& path, const CameraIntrinsics& intrinsics, double rms);
+
+// キャリブレーションした解像度と違う解像度で取得している場合は焦点距離と中心を合わせる
+void fitIntrinsics(CameraIntrinsics& intrinsics, cv::Size frameSize);
+
+// 検出した点だけを歪み補正する (フレーム全体の remap はしない)。
+// 結果は同じ camera_matrix で見た歪みのない画素座標
+void undistortPixels(const CameraIntrinsics& intrinsics, std::vector<cv::Point2f>& points);
+
+// 肩の座標を歪み補正する (-1 は未検出のまま)
+void undistortHumans(const CameraIntrinsics& intrinsics, std::vector<HumanPoseData>& humans);
+
+#endif // CAMERA_CALIBRATION_H
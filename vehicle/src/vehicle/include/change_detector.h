@@ -0,0 +1,36 @@
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+#include <opencv2/opencv.hpp>
+
+// 静止したシーンで重い処理 (net.forward()、detectMarkers) を省くための変化検出 (--gate)。
+// 画像を GATE_THUMB_SIZE の輝度に縮小し、最後に処理したフレーム (キーフレーム) との
+// 絶対差をブロックごとに平均する。どのブロックも GATE_THRESHOLD 未満なら「変化なし」。
+// 直前のフレームではなくキーフレームと比べるので、ゆっくりした変化も積もれば検出する。
+// absdiff と INTER_AREA の縮小は OpenCV の SIMD 実装を使う。
+
+const cv::Size GATE_THUMB_SIZE(80, 60);
+const cv::Size GATE_BLOCKS(8, 6);           // 10x10 画素のブロック
+const double GATE_THRESHOLD = 6.0;          // ブロックの平均絶対差 (輝度 0〜255)
+const double GATE_MAX_INTERVAL = 2.0;       // 変化がなくてもこの間隔 [s] で処理する
+
+class ChangeDetector {
+public:
+    ChangeDetector(double threshold = GATE_THRESHOLD, double max_interval = GATE_MAX_INTERVAL);
+
+    // image は BGR でも輝度 (CV_8UC1) でもよく、縮小済みでもよい。
+    // true なら処理する (このフレームが新しいキーフレームになる)。false なら前回の結果を使ってよい
+    bool update(const cv::Mat& image, double now);
+
+    // 最後に比べたときの最大のブロックの差 (閾値の調整用)
+    double lastDifference() const { return last_difference; }
+
+private:
+    double threshold;
+    double max_interval;
+    double keyframe_time;
+    double last_difference;
+    cv::Mat thumb, gray, keyframe, diff, blocks;
+};
+
+#endif // CHANGE_DETECTOR_H
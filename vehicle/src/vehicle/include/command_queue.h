@@ -0,0 +1,121 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// シリアルデバイスに送るコマンドのキュー (共有メモリ上に置く)。
+// 書き込みは複数のクライアント、読み出しは serial_mux だけ。
+// 各スロットの seq で空き/使用中を判定するのでロックは使わない。
+// push するたびに wake_seq を進め、serial_mux が眠っていれば futex で起こす
+// (プロセスをまたぐので FUTEX_PRIVATE_FLAG は付けない)。
+
+enum SerialDevice : uint8_t {
+    SERIAL_MOTOR = 0,
+    SERIAL_BATTERY = 1,
+    SERIAL_DEVICE_COUNT
+};
+
+struct SerialCommand {
+    std::atomic<uint32_t> seq;
+    uint8_t device;
+    uint8_t len;
+    char data[62];
+};
+
+const uint32_t COMMAND_QUEUE_SIZE = 64; // 2の累乗
+
+inline long futexCall(std::atomic<uint32_t>& word, int op, uint32_t value) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bit");
+    return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, nullptr, nullptr, 0);
+}
+
+struct SerialCommandQueue {
+    std::atomic<uint32_t> ready; // serial_mux が init() するまでは 0
+    std::atomic<uint32_t> enqueue_pos;
+    std::atomic<uint32_t> dequeue_pos;
+    std::atomic<uint32_t> wake_seq;  // push のたびに増える (futex のワード)
+    std::atomic<uint32_t> waiting;   // serial_mux が wake_seq で眠っていれば 1
+    SerialCommand slots[COMMAND_QUEUE_SIZE];
+
+    // 読み出し側 (serial_mux) が起動時に一度だけ呼ぶ
+    void init() {
+        ready.store(0, std::memory_order_relaxed);
+        for (uint32_t i = 0; i < COMMAND_QUEUE_SIZE; i++) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos.store(0, std::memory_order_relaxed);
+        dequeue_pos.store(0, std::memory_order_relaxed);
+        wake_seq.store(0, std::memory_order_relaxed);
+        waiting.store(0, std::memory_order_relaxed);
+        ready.store(1, std::memory_order_release);
+    }
+
+    // キューが満杯、または serial_mux が動いていなければ false
+    bool push(SerialDevice device, const char* data, size_t len) {
+        if (!ready.load(std::memory_order_acquire)) return false;
+        if (len > sizeof(slots[0].data)) return false;
+
+        uint32_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        SerialCommand* slot;
+        while (true) {
+            slot = &slots[pos & (COMMAND_QUEUE_SIZE - 1)];
+            uint32_t seq = slot->seq.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->device = device;
+        slot->len = (uint8_t)len;
+        memcpy(slot->data, data, len);
+        slot->seq.store(pos + 1, std::memory_order_release);
+        wake();
+        return true;
+    }
+
+    // 読み出し側を起こす。眠っていなければシステムコールは呼ばない
+    // (wake_seq を進めてから waiting を読み、読み出し側は waiting を立ててから wake_seq を確かめて眠るので、取りこぼさない)
+    void wake() {
+        wake_seq.fetch_add(1, std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_seq_cst)) futexCall(wake_seq, FUTEX_WAKE, INT32_MAX);
+    }
+
+    // 読み出し側: wake_seq が seen から進むまで眠る。進んでいれば新しい値を返す
+    uint32_t waitForPush(uint32_t seen) {
+        waiting.store(1, std::memory_order_seq_cst);
+        if (wake_seq.load(std::memory_order_seq_cst) == seen) futexCall(wake_seq, FUTEX_WAIT, seen);
+        waiting.store(0, std::memory_order_relaxed);
+        return wake_seq.load(std::memory_order_acquire);
+    }
+
+    bool push(SerialDevice device, const char* str) {
+        return push(device, str, strlen(str));
+    }
+
+    // 読み出し側は1プロセスだけなので CAS は不要
+    bool pop(SerialDevice& device, char* data, size_t& len) {
+        uint32_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        SerialCommand& slot = slots[pos & (COMMAND_QUEUE_SIZE - 1)];
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if ((int32_t)(seq - (pos + 1)) < 0) return false;
+
+        device = (SerialDevice)slot.device;
+        len = slot.len;
+        memcpy(data, slot.data, len);
+        dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+        slot.seq.store(pos + COMMAND_QUEUE_SIZE, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif // COMMAND_QUEUE_H
@@ -0,0 +1,30 @@
+#ifndef HUMAN_DETECTOR_H
+#define HUMAN_DETECTOR_H
+
+#include <vector>
+#include "shm_data.h"
+
+// detect_humanL / detect_humanR の本体 (カメラごとに書き込む共有メモリの領域だけが違う)
+enum HumanCamera {
+    HUMAN_CAMERA_L,
+    HUMAN_CAMERA_R
+};
+
+// カメラごとの書き込み先
+struct HumanSection {
+    const char* name;    // "L" / "R"
+    int* count;
+    HumanPoseData* humans;
+    double* update_time;
+    double* capture_time;
+};
+
+HumanSection humanSection(SharedMemoryData* shared_data, HumanCamera camera);
+
+// 追跡結果を共有メモリに書き込む (最大10人)。reused は前回の結果を書き直すとき (--gate)
+void publishHumans(const HumanSection& section, const std::vector<HumanPoseData>& humans,
+                   double timestamp, double capture_timestamp, bool reused = false);
+
+int runHumanDetector(int argc, char** argv, HumanCamera camera);
+
+#endif // HUMAN_DETECTOR_H
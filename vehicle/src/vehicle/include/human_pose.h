@@ -0,0 +1,50 @@
+#ifndef HUMAN_POSE_H
+#define HUMAN_POSE_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "shm_data.h"
+#include "pose_input.h"
+
+// OpenPose MobileNet (COCO) Keypoints mapping
+// 0: Nose, 1: Neck, 2: RShoulder, 3: RElbow, 4: RWrist,
+// 5: LShoulder, 6: LElbow, 7: LWrist, 8: RHip, 9: RKnee,
+// 10: RAnkle, 11: LHip, 12: LKnee, 13: LAnkle, 14: REye,
+// 15: LEye, 16: REar, 17: LEar, 18: Background
+const int NOSE = 0;
+const int NECK = 1;
+const int RIGHT_SHOULDER = 2;
+const int RIGHT_ELBOW = 3;
+const int RIGHT_WRIST = 4;
+const int LEFT_SHOULDER = 5;
+const int LEFT_ELBOW = 6;
+const int LEFT_WRIST = 7;
+const int RIGHT_EYE = 14;
+const int LEFT_EYE = 15;
+const int RIGHT_EAR = 16;
+const int LEFT_EAR = 17;
+
+const int POSE_PARTS = 18;
+const float PEAK_THRESHOLD = 0.1f;
+
+// フレーム座標 (サブピクセル)
+typedef std::vector<std::vector<cv::Point2f>> PosePeaks;
+
+// ヒートマップからピーク（極大値）を検出する関数
+std::vector<cv::Point> findPeaks(const cv::Mat& heatMap, float threshold);
+// peaks を使い回す版 (毎フレームの確保を避ける)
+void findPeaks(const cv::Mat& heatMap, float threshold, std::vector<cv::Point>& peaks);
+
+// ピークの周囲 3x3 に2次曲線を当てはめ、ヒートマップ座標でのサブピクセル位置を返す
+cv::Point2f refinePeak(const cv::Mat& heatMap, cv::Point peak);
+
+// ネットワークの出力 (1 x parts x H x W) から各パーツのピークを検出し、フレーム座標に戻す
+void extractPeaks(const cv::Mat& result, const PoseInput& input, PosePeaks& allPeaks);
+
+// 誤検知対策: 腕と顔が近くにある場合のみ肩として採用する
+bool isValidShoulder(const PosePeaks& allPeaks, cv::Point2f shoulder, bool isRight, cv::Size frameSize);
+
+// 人間のグルーピング (簡易版: 肩のペアリング)
+void groupHumans(const PosePeaks& allPeaks, cv::Size frameSize, std::vector<HumanPoseData>& detectedHumans);
+
+#endif // HUMAN_POSE_H
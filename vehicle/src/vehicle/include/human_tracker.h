@@ -11,14 +11,19 @@ struct TrackedHuman {
     cv::Point2f center;
     int consecutive_frames;
     int missing_frames;
+    TorsoAppearance appearance;   // 検出ごとのヒストグラムを平滑化したもの
 };
 
+// この回数続けて検出したらロックする (カメラ間の引き継ぎでは IdentityHandoff が lock() する)
+const int LOCK_FRAMES = 8;
+
 class HumanTracker {
 public:
     HumanTracker() : next_id(0), locked_id(-1) {}
 
-    void update(const std::vector<HumanPoseData>& detections) {
-        std::vector<bool> detection_used(detections.size(), false);
+    // appearances は detections と同じ順の胴体の色 (無ければ nullptr)
+    void update(const std::vector<HumanPoseData>& detections, const std::vector<TorsoAppearance>* appearances = nullptr) {
+        detection_used.assign(detections.size(), false);
         
         // 1. Update existing tracks
         for (auto& track : tracks) {
@@ -44,6 +49,7 @@ public:
                 track.center = getCenter(detections[best_match]);
                 track.consecutive_frames++;
                 track.missing_frames = 0;
+                if (appearances) blendAppearance(track.appearance, (*appearances)[best_match]);
                 detection_used[best_match] = true;
             } else {
                 track.consecutive_frames = 0; // Reset consecutive count if missed
@@ -59,6 +65,8 @@ public:
                 new_track.center = getCenter(detections[j]);
                 new_track.consecutive_frames = 1;
                 new_track.missing_frames = 0;
+                new_track.appearance.valid = false;
+                if (appearances) new_track.appearance = (*appearances)[j];
                 tracks.push_back(new_track);
             }
         }
@@ -79,7 +87,7 @@ public:
         // 4. Lock logic
         if (locked_id == -1) {
             for (const auto& track : tracks) {
-                if (track.consecutive_frames >= 8) {
+                if (track.consecutive_frames >= LOCK_FRAMES) {
                     locked_id = track.id;
                     break; 
                 }
@@ -89,6 +97,13 @@ public:
 
     std::vector<HumanPoseData> getResult() {
         std::vector<HumanPoseData> result;
+        getResult(result);
+        return result;
+    }
+
+    // result を使い回す版
+    void getResult(std::vector<HumanPoseData>& result) {
+        result.clear();
         if (locked_id != -1) {
             for (const auto& track : tracks) {
                 if (track.id == locked_id) {
@@ -96,14 +111,25 @@ public:
                     if (track.missing_frames < 5) {
                         result.push_back(track.data);
                     }
-                    return result;
+                    return;
                 }
             }
         }
-        return result;
     }
     
     int getLockedId() const { return locked_id; }
+
+    const std::vector<TrackedHuman>& getTracks() const { return tracks; }
+
+    const TrackedHuman* lockedTrack() const {
+        for (const auto& track : tracks) {
+            if (track.id == locked_id) return &track;
+        }
+        return nullptr;
+    }
+
+    // LOCK_FRAMES を待たずにロックする (もう一方のカメラからの引き継ぎ)
+    void lock(int id) { locked_id = id; }
     
     // Debug info
     void drawDebug(cv::Mat& frame) {
@@ -119,9 +145,23 @@ public:
 
 private:
     std::vector<TrackedHuman> tracks;
+    std::vector<bool> detection_used;
     int next_id;
     int locked_id;
 
+    static void blendAppearance(TorsoAppearance& track, const TorsoAppearance& detection) {
+        if (!detection.valid) return;
+        if (!track.valid) {
+            track = detection;
+            return;
+        }
+        // どちらも合計 1 なので、混ぜても合計 1 のまま
+        const float alpha = 0.2f;
+        for (int i = 0; i < APPEARANCE_H_BINS * APPEARANCE_S_BINS; i++) {
+            track.hist[i] = (1.0f - alpha) * track.hist[i] + alpha * detection.hist[i];
+        }
+    }
+
     cv::Point2f getCenter(const HumanPoseData& h) {
         int count = 0;
         cv::Point2f sum(0, 0);
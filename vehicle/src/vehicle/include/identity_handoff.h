@@ -0,0 +1,47 @@
+#ifndef IDENTITY_HANDOFF_H
+#define IDENTITY_HANDOFF_H
+
+#include <opencv2/opencv.hpp>
+#include "human_tracker.h"
+#include "shm_data.h"
+
+// カメラ間でロックしている人物を引き継ぐ (共有メモリの handoff)。
+// ロックしているカメラは、その人物の位置・胴体の色・時刻を毎フレーム書き込む。
+// ロックしていないカメラは、もう一方のカメラが直前まで重なりの範囲で見ていた人物と
+// 色の近い人物が自分の重なりの範囲に現れたら、LOCK_FRAMES を待たずにロックする。
+
+const double HANDOFF_WINDOW = 1.0;          // もう一方のカメラで見えなくなってから引き継げる時間 [s]
+const int HANDOFF_LOCK_FRAMES = 2;          // 引き継ぐのに必要な連続検出回数
+const float HANDOFF_MAX_DISTANCE = 0.35f;   // 胴体の色のバタチャリヤ距離の上限
+
+// image の中の胴体 (両肩から下) の色。human の座標は frameSize の解像度 (image は縮小されていてもよい)
+void torsoAppearance(const cv::Mat& image, cv::Size frameSize, const HumanPoseData& human, TorsoAppearance& appearance);
+
+// バタチャリヤ距離 (0 なら同じ、1 なら重なりなし)。どちらかが無効なら 1
+float appearanceDistance(const TorsoAppearance& a, const TorsoAppearance& b);
+
+class IdentityHandoff {
+public:
+    // camera: 0 = L, 1 = R。overlap_min/max: もう一方のカメラと重なる範囲 (画像の幅で割った x)
+    IdentityHandoff(IdentityHandoffData* shared, int camera, float overlap_min, float overlap_max);
+
+    // tracker.update() の直後に毎フレーム呼ぶ
+    void update(HumanTracker& tracker, cv::Size frameSize, double now);
+
+    // ロックしている人物の両カメラ共通の ID (ロックしていなければ 0)
+    int identity() const { return current_identity; }
+
+private:
+    bool inOverlap(const TrackedHuman& track, cv::Size frameSize) const;
+    // もう一方のカメラが直前まで重なりの範囲で見ていた人物。無ければ false
+    bool recentOtherTarget(double now, HandoffTarget& target) const;
+    void publish(const TrackedHuman& track, cv::Size frameSize, double now);
+
+    IdentityHandoffData* shared;
+    int camera;
+    float overlap_min, overlap_max;
+    int locked_track;       // 前回のフレームでロックしていた tracker の ID
+    int current_identity;
+};
+
+#endif // IDENTITY_HANDOFF_H
@@ -0,0 +1,45 @@
+#ifndef MARKER_POSE_H
+#define MARKER_POSE_H
+
+#include <map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// 正方形のマーカーの姿勢推定 (cv::aruco::estimatePoseSingleMarkers の置き換え)。
+// - マーカーごとに cv::parallel_for_ で並列に解く
+// - 初めて見る ID は正方形専用の解析解 (SOLVEPNP_IPPE_SQUARE) で求める
+// - 前のフレームで同じ ID の姿勢があれば、それを初期値に反復法で合わせ込む。
+//   小さく写ったマーカーでは平面の2つの解 (表裏) を取り違えて向きが跳ぶことがあるが、
+//   前回の姿勢から始めれば同じ側の解に収束する。合わなければ (再投影誤差が大きければ) 解析解に戻す
+// 角は歪み補正済み (歪み係数ゼロ) で渡す。角は4つで、順番は detectMarkers と同じ (左上から時計回り)
+
+const double MARKER_WARM_START_AGE = 0.5;      // これより古い姿勢は初期値に使わない [s]
+const double MARKER_WARM_START_ERROR = 1.0;    // 合わせ込んだ後の再投影誤差 (RMS) の上限 [px]
+
+class MarkerPoseEstimator {
+public:
+    explicit MarkerPoseEstimator(double marker_length, double max_age = MARKER_WARM_START_AGE);
+
+    // corners[i] (ID ids[i]) の姿勢を rvecs[i] / tvecs[i] に書き込む
+    void estimate(const std::vector<std::vector<cv::Point2f>>& corners, const std::vector<int>& ids,
+                  const cv::Mat& camera_matrix, double now,
+                  std::vector<cv::Vec3d>& rvecs, std::vector<cv::Vec3d>& tvecs);
+
+    // 直前の estimate で前回の姿勢から合わせ込めたマーカーの数
+    int warmStarted() const { return warm_started; }
+
+private:
+    struct Previous {
+        cv::Vec3d rvec, tvec;
+        double time;
+    };
+
+    std::vector<cv::Point3f> object_points;
+    double max_age;
+    std::map<int, Previous> previous;
+    std::vector<const Previous*> guesses;   // estimate の中で使う (ループの外で確保しておく)
+    std::vector<char> warm;
+    int warm_started;
+};
+
+#endif // MARKER_POSE_H
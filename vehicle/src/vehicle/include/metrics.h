@@ -0,0 +1,74 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+
+// 各プロセスが共有メモリの metrics に書き込むカウンタと遅延のヒストグラム。
+// 書き込みは relaxed の fetch_add だけなので、処理ループへの影響はほとんどない。
+// pipeline_stat が読み出し専用で開き、2回の読み出しの差からレートやパーセンタイルを求める。
+
+// 遅延のヒストグラムの区間: 4 µs 未満は 1 µs 刻み、それ以上は 2 倍ごとを 4 等分する (相対誤差 25% 以内)。
+// 96 区間で約 33 秒まで
+const int LATENCY_BUCKETS = 96;
+
+inline int latencyBucket(uint64_t us) {
+    if (us < 4) return (int)us;
+    int k = 63 - __builtin_clzll(us);   // floor(log2(us)) >= 2
+    int bucket = 4 * (k - 1) + (int)((us >> (k - 2)) & 3);
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// 区間 bucket の下端 [µs] (上端は latencyBucketLower(bucket + 1))
+inline double latencyBucketLower(int bucket) {
+    if (bucket < 4) return bucket;
+    int k = bucket / 4 + 1;
+    return (double)((uint64_t)(4 + bucket % 4) << (k - 2));
+}
+
+struct LatencyHistogram {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_us;
+    std::atomic<uint64_t> max_us;
+    std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+
+    void record(int64_t ns) {
+        uint64_t us = ns > 0 ? (uint64_t)ns / 1000 : 0;
+        buckets[latencyBucket(us)].fetch_add(1, std::memory_order_relaxed);
+        sum_us.fetch_add(us, std::memory_order_relaxed);
+        uint64_t max = max_us.load(std::memory_order_relaxed);
+        while (us > max && !max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// プロデューサー (ProducerId) ごとの統計
+struct ProducerMetrics {
+    std::atomic<uint64_t> frames;       // 処理して書き込んだフレーム (vehicle_pose は融合した観測、serial_mux は転送したコマンド)
+    std::atomic<uint64_t> dropped;      // 取りこぼしたフレーム (取得間隔からの推定と、壊れたフレーム)
+    std::atomic<uint64_t> reused;       // シーンが変わっていないので処理を省いたフレーム (--gate)
+    std::atomic<int32_t> queue_depth;   // 処理待ち・処理中のフレーム (姿勢推定のワーカー、serial_mux のコマンドキュー)
+    LatencyHistogram latency;           // フレームの取得から共有メモリへの書き込みまで
+    LatencyHistogram inference;         // 主な処理 (forward、detectMarkers、マーカーの融合)
+};
+
+// 取得間隔から取りこぼしたフレームを数える。間隔が公称の 1.5 倍を超えたら、その間のフレームを取りこぼしとする
+class FrameDropCounter {
+public:
+    explicit FrameDropCounter(double fps) : period_ns(fps > 0 ? 1e9 / fps : 0.0), last_ns(0) {}
+
+    // 今回のフレームの前に取りこぼした数
+    uint64_t update(int64_t capture_ns) {
+        int64_t gap = capture_ns - last_ns;
+        bool first = (last_ns == 0);
+        last_ns = capture_ns;
+        if (first || period_ns <= 0 || gap < period_ns * 1.5) return 0;
+        return (uint64_t)(gap / period_ns + 0.5) - 1;
+    }
+
+private:
+    double period_ns;
+    int64_t last_ns;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,31 @@
+#ifndef MJPEG_DECODER_H
+#define MJPEG_DECODER_H
+
+#include <opencv2/opencv.hpp>
+
+// MJPEG カメラの JPEG をそのまま受け取り、libjpeg-turbo でデコードする。
+// 縮小デコード (DCT 領域で 1/2, 1/4, 1/8) を使うと、ネットワークの入力に必要な大きさだけを
+// フルサイズのデコード + 縮小よりずっと軽く得られる。スレッドごとに1つ使う。
+class MjpegDecoder {
+public:
+    MjpegDecoder();
+    ~MjpegDecoder();
+    MjpegDecoder(const MjpegDecoder&) = delete;
+    MjpegDecoder& operator=(const MjpegDecoder&) = delete;
+
+    // ヘッダだけを読んで元の解像度を返す
+    bool readSize(const cv::Mat& jpeg, cv::Size& size);
+
+    // 縮小した画像が target を覆う (幅か高さが target 以上になる) 範囲で、最も小さくデコードする
+    bool decodeScaled(const cv::Mat& jpeg, cv::Size target, cv::Mat& bgr);
+
+    // 元の解像度でデコードする (デバッグ表示など、必要なときだけ)
+    bool decodeFull(const cv::Mat& jpeg, cv::Mat& bgr);
+
+private:
+    bool decode(const cv::Mat& jpeg, cv::Size full, int scale_denom, cv::Mat& bgr);
+
+    void* handle;
+};
+
+#endif // MJPEG_DECODER_H
@@ -0,0 +1,88 @@
+#ifndef PERCEPTION_H
+#define PERCEPTION_H
+
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "shm_data.h"
+
+// 各検出プログラムで共通の処理 (libvehicle_perception)
+
+const char* const SHM_NAME = "/aruco_data";
+
+// コマンドライン引数
+struct PerceptionOptions {
+    std::string camera;     // カメラデバイスのパス、ID、または録画ファイル
+    bool headless = false;  // ウィンドウを出さない (録画の再生やPGOの学習用)
+    int workers = 1;        // 姿勢推定を並列に行うフレーム数 (detect_humanL/R のみ)
+    int warmup = 2;         // カメラを開く前にダミーの入力で推論する回数 (detect_humanL/R のみ)
+    std::string calibration; // calibrate_camera で作った内部パラメータ (空なら既定値)
+    bool mjpeg = false;     // MJPEG をデコードせずに受け取り、必要な大きさだけ縮小デコードする (detect_humanL/R のみ)
+    bool luma = false;      // YUYV をそのまま受け取り、輝度 (Y) だけで検出する (marker_detect のみ)
+    bool gate = false;      // シーンが変わっていなければ推論・検出を省き、前回の結果を書き直す
+    float overlap[2] = {-1.0f, -1.0f}; // もう一方のカメラと重なる x の範囲 (画像の幅で割った値。負なら既定値。detect_humanL/R のみ)
+};
+
+// 失敗したら Usage を表示して false を返す
+bool parsePerceptionOptions(int argc, char** argv, PerceptionOptions& options);
+
+// 数字ならカメラID、/dev 以外の既存ファイルなら録画として開く
+bool openCamera(cv::VideoCapture& cap, const std::string& camera);
+
+// MJPEG で取得し、V4L2 バックエンドにデコードさせずに JPEG のまま retrieve() させる。
+// 成功すると grabFrame は 1 x N の CV_8UC1 (JPEG のバイト列) を返す
+bool enableRawMjpeg(cv::VideoCapture& cap);
+
+// YUYV で取得し、BGR への変換 (CAP_PROP_CONVERT_RGB) を止める。
+// 成功すると grabFrame は YUYV のバッファ (1 x N の CV_8UC1 か H x W の CV_8UC2。バックエンドの版による) を返す
+bool enableRawYuyv(cv::VideoCapture& cap);
+
+// grabFrame が返した YUYV のバッファを、コピーせずに H x W の CV_8UC2 (Y, U/V の組) として見る。
+// 行末に詰め物があれば step に反映する。大きさが合わなければ false
+bool wrapYuyv(const cv::Mat& raw, cv::Size size, cv::Mat& yuyv);
+
+// writable なら作成してサイズを設定する。読むだけなら既存のものを開く
+SharedMemoryData* openSharedMemory(bool writable, int& shm_fd);
+void closeSharedMemory(SharedMemoryData* shared_data, int shm_fd);
+
+// SIGINT/SIGTERM (supervisor はステージを SIGTERM で止める) で検出ループを抜けられるようにする。
+// ハンドラはフラグを立てるだけなので、ループは stopRequested() を見て普通に main から戻る
+// (カメラの解放や、perf カウンタの集計の表示はその後の終了処理で行われる)
+void installStopHandler();
+bool stopRequested();
+
+// supervisor から渡された OpenCV のスレッド数 (VEHICLE_CV_THREADS) を cv::setNumThreads に反映する
+void applyThreadBudget();
+
+// supervisor の設定ファイルで使う名前 ("marker", "human_L", "human_R", "serial_mux", "vehicle_pose")
+const char* producerName(ProducerId id);
+
+// 自分の PID を登録し、以後ループごとに heartbeat() を呼ぶ
+void registerProducer(SharedMemoryData* shared_data, ProducerId id);
+void heartbeat(SharedMemoryData* shared_data, ProducerId id);
+
+// 起動にかかった時間を段階ごとに測る (main の先頭で作る)
+class StartupTimer {
+public:
+    StartupTimer();
+    // 前の段階の終わり (最初は作ったとき) からここまでを name の段階とする
+    void phase(const char* name);
+    double totalMs() const;
+    // "model 850 ms, warmup 420 ms, ... (total 1500 ms)"
+    std::string summary() const;
+
+private:
+    int64_t begin_ns;
+    int64_t last_ns;
+    std::vector<std::pair<std::string, double>> phases;
+};
+
+// 最初の結果を書き込んだら呼ぶ。ready を立て、起動時間の内訳を表示する
+void markReady(SharedMemoryData* shared_data, ProducerId id, const StartupTimer& startup);
+
+// 1フレーム取得し、grab() が返った時刻 (CLOCK_MONOTONIC [ns]) を capture_ns に入れる
+bool grabFrame(cv::VideoCapture& cap, cv::Mat& frame, int64_t& capture_ns);
+
+#endif // PERCEPTION_H
@@ -0,0 +1,85 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// 各段のハードウェアカウンタ (perf_event_open) をプロセスごとの共有メモリ (/vehicle_perf_<名前>) に集計する。
+// 環境変数 VEHICLE_PERF を設定したときだけ有効になる。TraceSpan の区間ごとに読むので、段の分け方はトレースと同じ。
+// カウンタはスレッドごとに開く (姿勢推定のワーカーも別々に数える)。開けないカウンタ
+// (仮想マシン、perf_event_paranoid、PMU の数が足りないなど) は数えずに続ける。
+// 集計は終了時 (main から戻ったとき。SIGINT/SIGTERM でも installStopHandler でループを抜ける) に表示する。
+// 共有メモリは終了後も pipeline_stat --perf で読めるように残し、次に起動した supervisor が消す
+
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,        // L1 データキャッシュの読み込みミス
+    PERF_LLC_MISSES,        // 最終レベルキャッシュの読み込みミス
+    PERF_BRANCH_MISSES,
+    PERF_CONTEXT_SWITCHES,
+    PERF_COUNTER_COUNT
+};
+
+const char* perfCounterName(int counter);
+
+const uint32_t PERF_MAX_STAGES = 16;    // TRACE_STAGE_COUNT 以上
+const uint32_t PERF_MAGIC = 0x50524631; // "PRF1"
+
+struct PerfStageTotals {
+    std::atomic<uint64_t> spans;
+    std::atomic<uint64_t> time_ns;
+    std::atomic<uint64_t> unscheduled;  // カウンタが1度も動かなかった区間 (PMU の取り合いに負けたなど)
+    std::atomic<uint64_t> values[PERF_COUNTER_COUNT];
+};
+
+struct PerfBlock {
+    uint32_t magic;
+    int32_t pid;
+    char process[32];
+    std::atomic<uint32_t> available;    // 開けたカウンタ (1 << PerfCounter) のビット和
+    PerfStageTotals stages[PERF_MAX_STAGES];
+};
+
+const char* const PERF_SHM_PREFIX = "/vehicle_perf_";
+
+// 区間の始まりで読んだ値
+struct PerfSample {
+    bool valid;
+    int64_t begin_ns;
+    uint64_t enabled, running;  // 多重化の補正用
+    uint64_t values[PERF_COUNTER_COUNT];
+};
+
+class PerfCounters {
+public:
+    static PerfCounters& instance() {
+        static PerfCounters counters;
+        return counters;
+    }
+
+    // VEHICLE_PERF が設定されていれば集計用の共有メモリを作る
+    void open(const char* process);
+
+    bool enabled() const { return block != nullptr; }
+
+    // 呼んだスレッドのカウンタを読む (初回はそのスレッドのカウンタを開く)
+    void begin(PerfSample& sample);
+    // begin() からの増分を stage に足す。同じプロセスの複数スレッドから呼べる
+    void end(uint32_t stage, const PerfSample& sample);
+
+    // 終了時に段ごとの集計をコンソールに出す
+    ~PerfCounters();
+
+private:
+    PerfCounters() : block(nullptr) {}
+    PerfBlock* block;
+    std::string shm_name;
+};
+
+// 段ごとの区間数、1区間あたりのサイクル数、IPC、1000命令あたりのミス数などを表で出す
+void printPerfSummary(const PerfBlock& block, std::ostream& out);
+
+#endif // PERF_COUNTERS_H
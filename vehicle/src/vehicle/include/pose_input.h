@@ -0,0 +1,46 @@
+#ifndef POSE_INPUT_H
+#define POSE_INPUT_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// 姿勢推定ネットワークの入力テンソル (1 x 3 x H x W, RGB, float, 127.5 を引いた値)。
+// blobFromImage の代わりに、フレームをアスペクト比を保ったまま縮小 (レターボックス) して
+// 確保済みのテンソルに直接書き込む。縮小・BGR→RGB・平均値の減算・NCHWへの並べ替えを
+// 1回の走査で行い、フレームサイズが変わらない限りメモリ確保は起きない。
+class PoseInput {
+public:
+    explicit PoseInput(cv::Size inputSize = cv::Size(368, 368));
+
+    // frame は 8bit BGR。frame が縮小デコードしたものなら、元の解像度を originalSize に渡すと
+    // toFrame() が元の解像度の座標を返す
+    void set(const cv::Mat& frame, cv::Size originalSize = cv::Size());
+
+    const cv::Mat& blob() const { return tensor; }
+    cv::Size inputSize() const { return input; }
+
+    // ネットワーク入力の画素座標 → フレームの画素座標 (レターボックスの逆変換)
+    cv::Point2f toFrame(cv::Point2f p) const {
+        return cv::Point2f((p.x + 0.5f - pad_x) / scale * original_x - 0.5f, (p.y + 0.5f - pad_y) / scale * original_y - 0.5f);
+    }
+
+private:
+    void configure(cv::Size frameSize);
+
+    cv::Size input;
+    cv::Size frame_size;
+    float scale;
+    int pad_x, pad_y;
+    float original_x, original_y;   // 元の解像度 / frame の解像度
+    cv::Rect content;   // 入力のうちフレームが写っている範囲
+
+    cv::Mat tensor;
+
+    // 出力の各列・各行に対応する元画像の2点と重み (バイリニア補間)
+    std::vector<int> src_x0, src_x1;    // バイト単位のオフセット (x * 3)
+    std::vector<float> weight_x;
+    std::vector<int> src_y0, src_y1;
+    std::vector<float> weight_y;
+};
+
+#endif // POSE_INPUT_H
@@ -0,0 +1,102 @@
+#ifndef POSE_WORKER_POOL_H
+#define POSE_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include "human_pose.h"
+#include "pose_input.h"
+#include "shm_data.h"
+
+// 1フレーム分の姿勢推定 (前処理〜グルーピング)。トラッキングはフレーム順に行う必要があるので含めない
+struct PoseJob {
+    uint64_t seq;
+    int64_t capture_ns;
+    cv::Mat frame;          // 取得したフレーム (BGR)。jpeg で取得したときは表示が必要になるまで空
+    cv::Mat jpeg;           // MJPEG をデコードせずに取得したとき (--mjpeg)
+    cv::Mat decoded;        // jpeg をネットワークの入力の大きさまで縮小デコードしたもの
+    cv::Size frame_size;    // 元の解像度 (peaks / humans の座標はこの解像度)
+    PoseInput input;
+    PosePeaks peaks;
+    std::vector<HumanPoseData> humans;
+    std::vector<TorsoAppearance> appearances;  // humans と同じ順の胴体の色 (カメラ間の引き継ぎ用)
+    int64_t forward_ns;     // net.forward() にかかった時間 (0 なら推論していない)
+    bool reused;            // シーンが変わっていないので推論しない (--gate。取得順を保つためにプールは通す)
+    bool done;
+};
+
+// ネットワークを読み込んで CPU バックエンドに設定する。失敗したら空の Net を返す。
+// data / size はモデルファイル (graph_opt.pb) の中身 (PoseWorkerPool は mmap したものを渡す)
+cv::dnn::Net loadPoseNet(const char* data, size_t size);
+
+// ダミーの入力で count 回推論する。最初の数回の forward() は層の確保や初期化で定常状態よりずっと遅いので、
+// カメラを開く前に済ませておく
+void warmUpPoseNet(cv::dnn::Net& net, int count);
+
+// job->frame から job->peaks / job->humans / job->appearances を求める
+void runPoseJob(cv::dnn::Net& net, PoseJob& job);
+
+// フレーム単位の並列化。Net をワーカーの数だけ持ち、フレームを順番に割り振る。
+// 結果はリオーダーバッファを通すので、next() は取得した順にしか返さない。
+// workers が 1 以下ならスレッドを作らず submit() の中で処理する。
+// モデルファイルは1回だけ mmap し、ワーカーごとの Net はそこから並列に読み込む。
+//
+//   PoseJob* job = pool.acquire();     空きのジョブ (無ければ nullptr)
+//   grabFrame(cap, job->frame, ...);
+//   pool.submit(job);
+//   PoseJob* done = pool.next(wait);   最も古いジョブが終わっていれば返す
+//   ... tracker.update(done->humans) ...
+//   pool.release(done);
+class PoseWorkerPool {
+public:
+    // depth: 同時に処理中にできるフレーム数 (ワーカー数以上)
+    PoseWorkerPool(const std::string& modelFile, int workers, int depth);
+    ~PoseWorkerPool();
+
+    // すべての Net を並列に count 回ずつ空回しする (submit() の前に呼ぶ)
+    void warmUp(int count);
+
+    bool ok() const { return loaded; }
+    int workers() const { return (int)nets.size(); }
+    size_t inFlight() const { return in_flight; }
+
+    PoseJob* acquire();
+    void submit(PoseJob* job);
+    // 取得順で次のジョブ。wait が false なら終わっていなければ nullptr
+    PoseJob* next(bool wait);
+    // 使い終わったジョブ、または submit しなかったジョブを空きに戻す
+    void release(PoseJob* job);
+
+private:
+    struct Worker {
+        std::thread thread;
+        std::deque<PoseJob*> queue;
+        std::condition_variable cv;
+    };
+
+    void workerLoop(int index);
+
+    bool loaded;
+    std::vector<cv::dnn::Net> nets;
+    std::vector<std::unique_ptr<Worker>> threads;
+
+    std::vector<std::unique_ptr<PoseJob>> jobs;
+    std::vector<PoseJob*> free_jobs;
+    std::vector<PoseJob*> reorder;   // seq % depth の位置に置く
+    uint64_t next_submit;
+    uint64_t next_result;
+    size_t in_flight;
+
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    bool stopping;
+};
+
+#endif // POSE_WORKER_POOL_H
@@ -0,0 +1,35 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+// 共有メモリ上の値を、読み手がロックなしで何度でも読めるように seqlock で書き込む。
+// 書き手は1プロセスだけ。T はコピーできる POD に限る
+template <typename T>
+struct Seqlock {
+    std::atomic<uint32_t> seq;  // 奇数なら書き込み中
+    T value;
+
+    void write(const T& v) {
+        uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = v;
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    // 書き込み中に当たったら読み直す。一度も書かれていなければ false
+    bool read(T& v) const {
+        for (int retry = 0; retry < 100; retry++) {
+            uint32_t s1 = seq.load(std::memory_order_acquire);
+            if (s1 & 1) continue;
+            v = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq.load(std::memory_order_relaxed) == s1) return s1 != 0;
+        }
+        return false;
+    }
+};
+
+#endif // SEQLOCK_H
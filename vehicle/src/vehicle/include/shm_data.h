@@ -1,11 +1,38 @@
 #ifndef SHM_DATA_H
 #define SHM_DATA_H
 
+#include "command_queue.h"
+#include "metrics.h"
+#include "seqlock.h"
+#include "vehiclepose.hpp"
+
+// 時刻はすべて CLOCK_MONOTONIC の秒 (trace.h の monotonicNow())。
+// system_clock は NTP で飛ぶので、プロセス間の鮮度比較には使わない。
+
+// marker_detect はマーカーの一辺をこの長さとして tvec を求める。
+// 実際の大きさが違うマーカーは、読む側で (実際の一辺 / MARKER_LENGTH) 倍する
+const double MARKER_LENGTH = 0.05; // [m]
+
+// 共有メモリに書き込めるマーカーの数。marker_detect の辞書 (DICT_4X4_50) の ID の数と同じにしてあるので、
+// コースにマーカーを足しても溢れない。溢れた場合は近いものから MAX_MARKERS 個を書き込む
+const int MAX_MARKERS = 50;
+
 struct ArUcoMarkerData {
     int id;
     double tvec[3];  // 平行移動ベクトル [x, y, z]
     double rvec[3];  // 回転ベクトル [rx, ry, rz]
-    double timestamp; // タイムスタンプ
+    double timestamp; // タイムスタンプ (書き込み時刻)
+    double capture_timestamp; // フレームを取得した時刻
+    bool reused;      // シーンが変わっていないので検出を省き、前回の結果を書き直したもの (--gate)
+};
+
+// marker_detect が1フレームごとに書き込むマーカー。読む側は Seqlock::read で丸ごとコピーする
+// (書き込み中のフレームや、次のフレームで上書きされている途中のマーカーを読まないように)
+struct MarkerFrame {
+    int count;                            // markers に書き込んだ数 (MAX_MARKERS 以下)
+    ArUcoMarkerData markers[MAX_MARKERS];
+    double update_time;                   // 書き込み時刻
+    double capture_time;                  // フレームを取得した時刻
 };
 
 struct HumanPoseData {
@@ -14,24 +41,105 @@ struct HumanPoseData {
                               // User asked for coordinates. Pixel is usually easier for overlay, but normalized is better for logic.
                               // Let's stick to what OpenCV usually gives or convert to pixel.
     double right_shoulder[2]; // [x, y]
-    double timestamp;
+    double timestamp;         // 書き込み時刻
+    double capture_timestamp; // フレームを取得した時刻
+    bool reused;              // シーンが変わっていないので推論を省き、前回の結果を書き直したもの (--gate)
+};
+
+// 胴体の色 (HSV の H-S ヒストグラム、合計 1 に正規化)。カメラ間で同じ人物かどうかの手掛かりにする
+const int APPEARANCE_H_BINS = 8;
+const int APPEARANCE_S_BINS = 4;
+
+struct TorsoAppearance {
+    bool valid;     // 両肩が見えていて胴体の領域がとれたとき
+    float hist[APPEARANCE_H_BINS * APPEARANCE_S_BINS];
+};
+
+// detect_humanL/R がロックしている人物。もう一方のカメラがロックを引き継ぐときに読む
+struct HandoffTarget {
+    int identity;           // 両カメラで共通の ID (1 から。0 ならまだロックしていない)
+    double last_seen;       // 最後に検出した時刻
+    float x, y;             // 最後の位置 (画像の幅・高さで割ったもの)
+    bool in_overlap;        // 最後の位置がもう一方のカメラとの重なりの範囲にあったか
+    TorsoAppearance appearance;
+};
+
+struct IdentityHandoffData {
+    std::atomic<int> last_identity;     // 新しくロックするたびに増やす
+    Seqlock<HandoffTarget> cameras[2];  // [0] = L, [1] = R
+};
+
+// serial_mux が書き込む車両ボードの状態
+struct VehicleStatusData {
+    int battery_level;              // battery.ino が送ってくる電圧 [mV] (フィルタ済み)
+    int battery_percent;            // 残量 [%] (battery.ino の BATTERY_EMPTY_MV〜BATTERY_FULL_MV)
+    double battery_update_time;
+    float motor_vR, motor_vL;       // motor.ino の move() が最後に出力した車輪速度
+    unsigned int motor_ack_count;   // motor.ino から受け取った行数
+    char motor_last_line[64];
+    double motor_update_time;
+    double serial_mux_heartbeat;    // serial_mux が動いていれば定期的に更新される
+};
+
+// supervisor が生存を監視するプロセス
+enum ProducerId {
+    PRODUCER_MARKER,
+    PRODUCER_HUMAN_L,
+    PRODUCER_HUMAN_R,
+    PRODUCER_SERIAL_MUX,
+    PRODUCER_VEHICLE_POSE,
+    PRODUCER_COUNT
+};
+
+struct ProducerStatus {
+    int pid;            // 書き込んでいるプロセス (0 なら未登録)
+    double heartbeat;   // 処理ループを1周するたびに更新
+    bool ready;         // 起動処理 (モデルの読み込み、ウォームアップ) が終わり、最初の結果を書き込んだ
+    float startup_ms;   // 起動から ready までの時間
+};
+
+// pipeline_stat で見る統計 (metrics.h)
+struct PipelineMetrics {
+    ProducerMetrics producers[PRODUCER_COUNT];
+};
+
+// 共有メモリは supervisor が作成・初期化・削除する (supervisor なしで起動した場合は supervisor_pid = 0)
+struct PipelineStatus {
+    int supervisor_pid;
+    ProducerStatus producers[PRODUCER_COUNT];
 };
 
 struct SharedMemoryData {
     // Marker Data
-    int marker_count;
-    ArUcoMarkerData markers[10]; // 最大10個のマーカー
-    double last_marker_update_time;
+    Seqlock<MarkerFrame> marker_frame;
 
     // Human Data L
     int human_count_L;
     HumanPoseData humans_L[10]; // 最大10人の人間 (Camera L)
     double last_human_update_time_L;
+    double last_human_capture_time_L;
 
     // Human Data R
     int human_count_R;
     HumanPoseData humans_R[10]; // 最大10人の人間 (Camera R)
     double last_human_update_time_R;
+    double last_human_capture_time_R;
+
+    // Vehicle boards (serial_mux)
+    VehicleStatusData vehicle_status;
+    SerialCommandQueue serial_commands; // クライアントからボードへのコマンド
+
+    // 車両の姿勢 (vehicle_pose が一定周期で書き込む)
+    SharedVehiclePose vehicle_pose;
+
+    // カメラ間のロックの引き継ぎ (detect_humanL/R)
+    IdentityHandoffData handoff;
+
+    // 各プロデューサーの統計
+    PipelineMetrics metrics;
+
+    // Supervisor
+    PipelineStatus pipeline;
 };
 
 #endif // SHM_DATA_H
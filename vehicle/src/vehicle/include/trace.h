@@ -0,0 +1,171 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "perf_counters.h"
+
+// 各段の処理時間をプロセスごとのリングバッファ (共有メモリ /vehicle_trace_<名前>) に記録する。
+// 環境変数 VEHICLE_TRACE を設定したときだけ有効になり、未設定なら何もしない。
+// 記録したイベントは trace_merge で Chrome の trace-event JSON にまとめる。
+// 共有メモリはプロセスが終わっても残す。消すのは trace_merge --unlink か、次に起動した supervisor
+// VEHICLE_PERF を設定すると、同じ区間でハードウェアカウンタも集計する (perf_counters.h)。
+
+// CLOCK_MONOTONIC の現在時刻 [ns]
+inline int64_t monotonicNowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// CLOCK_MONOTONIC の現在時刻 [s] (共有メモリのタイムスタンプ用)
+inline double monotonicNow() {
+    return monotonicNowNs() * 1e-9;
+}
+
+enum TraceStage : uint32_t {
+    TRACE_CAPTURE = 0,
+    TRACE_PREPROCESS,
+    TRACE_FORWARD,
+    TRACE_PEAKS,
+    TRACE_GROUPING,
+    TRACE_TRACKING,
+    TRACE_PUBLISH,
+    TRACE_CONSUME,
+    TRACE_DETECT,
+    TRACE_POSE,
+    TRACE_FUSE,
+    TRACE_DECODE,
+    TRACE_STAGE_COUNT
+};
+
+inline const char* traceStageName(uint32_t stage) {
+    static const char* names[TRACE_STAGE_COUNT] = {
+        "capture", "preprocess", "forward", "peaks", "grouping",
+        "tracking", "publish", "consume", "detect", "pose", "fuse", "decode"};
+    return stage < TRACE_STAGE_COUNT ? names[stage] : "unknown";
+}
+
+struct TraceEvent {
+    // seq は (書き込み番号 * 2 + 1) で書き込み中、(書き込み番号 * 2 + 2) で完了を表す
+    std::atomic<uint64_t> seq;
+    uint32_t stage;
+    uint32_t tid;
+    int64_t begin_ns;
+    int64_t end_ns;
+    int64_t capture_ns; // このイベントが処理しているフレームの取得時刻 (不明なら 0)
+};
+
+const uint32_t TRACE_MAGIC = 0x54524331; // "TRC1"
+const size_t TRACE_RING_SIZE = 8192;     // 2の累乗
+
+struct TraceRing {
+    uint32_t magic;
+    int32_t pid;
+    char process[32];
+    std::atomic<uint64_t> head; // 次に書き込む番号
+    TraceEvent events[TRACE_RING_SIZE];
+};
+
+const char* const TRACE_SHM_PREFIX = "/vehicle_trace_";
+
+class TraceRecorder {
+public:
+    static TraceRecorder& instance() {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    // VEHICLE_TRACE が設定されていればリングバッファを作る (VEHICLE_PERF はそれとは別に見る)
+    void open(const char* process) {
+        PerfCounters::instance().open(process);
+        if (ring || !getenv("VEHICLE_TRACE")) return;
+
+        shm_name = std::string(TRACE_SHM_PREFIX) + process;
+        int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0666);
+        if (fd == -1) return;
+        if (ftruncate(fd, sizeof(TraceRing)) == -1) {
+            close(fd);
+            return;
+        }
+        void* p = mmap(nullptr, sizeof(TraceRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) return;
+
+        ring = static_cast<TraceRing*>(p);
+        memset(static_cast<void*>(ring), 0, sizeof(TraceRing));
+        ring->pid = getpid();
+        strncpy(ring->process, process, sizeof(ring->process) - 1);
+        ring->magic = TRACE_MAGIC;
+    }
+
+    bool enabled() const { return ring != nullptr; }
+
+    // 書き込み番号は fetch_add で取るので、同じプロセスの複数スレッド (姿勢推定のワーカー) から呼べる。
+    // 読み手は各イベントの seq で書き込み完了を確認する
+    void record(TraceStage stage, int64_t begin_ns, int64_t end_ns, int64_t capture_ns) {
+        if (!ring) return;
+        uint64_t n = ring->head.fetch_add(1, std::memory_order_relaxed);
+        TraceEvent& e = ring->events[n & (TRACE_RING_SIZE - 1)];
+        e.seq.store(n * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        e.stage = stage;
+        e.tid = (uint32_t)gettid();
+        e.begin_ns = begin_ns;
+        e.end_ns = end_ns;
+        e.capture_ns = capture_ns;
+        e.seq.store(n * 2 + 2, std::memory_order_release);
+    }
+
+    ~TraceRecorder() {
+        if (ring) munmap(ring, sizeof(TraceRing));
+    }
+
+private:
+    TraceRecorder() : ring(nullptr) {}
+    TraceRing* ring;
+    std::string shm_name;
+};
+
+// スコープを抜けたときにその区間を記録する
+class TraceSpan {
+public:
+    TraceSpan(TraceStage stage, int64_t capture_ns = 0)
+        : stage(stage), capture_ns(capture_ns),
+          begin_ns(TraceRecorder::instance().enabled() ? monotonicNowNs() : 0), done(false) {
+        perf.valid = false;
+        if (PerfCounters::instance().enabled()) PerfCounters::instance().begin(perf);
+    }
+
+    ~TraceSpan() { end(); }
+
+    // スコープより前で区間を閉じたいとき用
+    void end() {
+        if (done) return;
+        done = true;
+        TraceRecorder& recorder = TraceRecorder::instance();
+        if (recorder.enabled()) recorder.record(stage, begin_ns, monotonicNowNs(), capture_ns);
+        PerfCounters& counters = PerfCounters::instance();
+        if (counters.enabled()) counters.end(stage, perf);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    TraceStage stage;
+    int64_t capture_ns;
+    int64_t begin_ns;
+    bool done;
+    PerfSample perf;
+};
+
+#endif // TRACE_H
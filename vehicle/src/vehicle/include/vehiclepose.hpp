@@ -0,0 +1,317 @@
+#ifndef VEHICLEPOSE_HPP
+#define VEHICLEPOSE_HPP
+
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include "seqlock.h"
+
+// 車両の位置・向き (地図座標、床面の2次元)。
+// vehicle_pose がマーカーから推定し、共有メモリの vehicle_pose に一定周期で書き込む。
+//
+// 座標系
+//   地図 (world): x, y が床面、z が上
+//   車両 (vehicle): x が前、y が左、z が上。原点は車両の中心 (床面)
+//   カメラ: OpenCV と同じ (x が右、y が下、z が光軸)
+//   マーカー: ArUco と同じ (x が右、y が上、z がマーカーの表側)
+
+struct VehiclePose {
+    bool valid;                 // 一度でもマーカーが見えていれば true
+    double x, y;                // [m]
+    double theta;               // [rad] 地図の x 軸から反時計回り (-pi, pi]
+    double v, omega;            // 速度 [m/s]、角速度 [rad/s] (EKF の推定値)
+    double covariance[9];       // (x, y, theta) の共分散 3x3 (行優先)
+    double timestamp;           // この姿勢の時刻 (書き込み時刻まで外挿済み)
+    double measurement_time;    // 最後に使ったマーカーのフレームの取得時刻
+    int markers_used;           // 最後の更新で使ったマーカーの数
+};
+
+// 読み手は何度でも読めるように seqlock で書き込む (書き手は vehicle_pose だけ)
+typedef Seqlock<VehiclePose> SharedVehiclePose;
+
+// ---- 3次元の剛体変換 ----
+
+struct Pose3 {
+    double R[3][3];
+    double t[3];
+
+    static Pose3 identity() {
+        Pose3 p = {{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, {0, 0, 0}};
+        return p;
+    }
+
+    // ロール・ピッチ・ヨー [rad] (Z-Y-X の順に回す)
+    static Pose3 fromRPY(double x, double y, double z, double roll, double pitch, double yaw) {
+        double cr = std::cos(roll), sr = std::sin(roll);
+        double cp = std::cos(pitch), sp = std::sin(pitch);
+        double cy = std::cos(yaw), sy = std::sin(yaw);
+        Pose3 p = {{{cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr},
+                    {sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr},
+                    {-sp, cp * sr, cp * cr}},
+                   {x, y, z}};
+        return p;
+    }
+
+    // OpenCV の rvec/tvec (Rodrigues)
+    static Pose3 fromRvecTvec(const double rvec[3], const double tvec[3]) {
+        Pose3 p = identity();
+        double angle = std::sqrt(rvec[0] * rvec[0] + rvec[1] * rvec[1] + rvec[2] * rvec[2]);
+        if (angle > 1e-12) {
+            double k[3] = {rvec[0] / angle, rvec[1] / angle, rvec[2] / angle};
+            double c = std::cos(angle), s = std::sin(angle), v = 1 - c;
+            p.R[0][0] = c + k[0] * k[0] * v;
+            p.R[0][1] = k[0] * k[1] * v - k[2] * s;
+            p.R[0][2] = k[0] * k[2] * v + k[1] * s;
+            p.R[1][0] = k[1] * k[0] * v + k[2] * s;
+            p.R[1][1] = c + k[1] * k[1] * v;
+            p.R[1][2] = k[1] * k[2] * v - k[0] * s;
+            p.R[2][0] = k[2] * k[0] * v - k[1] * s;
+            p.R[2][1] = k[2] * k[1] * v + k[0] * s;
+            p.R[2][2] = c + k[2] * k[2] * v;
+        }
+        for (int i = 0; i < 3; i++) p.t[i] = tvec[i];
+        return p;
+    }
+
+    Pose3 operator*(const Pose3& o) const {
+        Pose3 p;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                p.R[i][j] = R[i][0] * o.R[0][j] + R[i][1] * o.R[1][j] + R[i][2] * o.R[2][j];
+            }
+            p.t[i] = R[i][0] * o.t[0] + R[i][1] * o.t[1] + R[i][2] * o.t[2] + t[i];
+        }
+        return p;
+    }
+
+    Pose3 inverse() const {
+        Pose3 p;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) p.R[i][j] = R[j][i];
+        }
+        for (int i = 0; i < 3; i++) {
+            p.t[i] = -(p.R[i][0] * t[0] + p.R[i][1] * t[1] + p.R[i][2] * t[2]);
+        }
+        return p;
+    }
+
+    // 床面に射影したときの向き (x 軸の方位)
+    double yaw() const { return std::atan2(R[1][0], R[0][0]); }
+};
+
+inline double wrapAngle(double a) {
+    while (a > M_PI) a -= 2 * M_PI;
+    while (a <= -M_PI) a += 2 * M_PI;
+    return a;
+}
+
+// ---- マーカー地図 ----
+
+// 地図ファイル (vehicle/config/marker_map.txt)
+//   camera <x> <y> <z> <roll> <pitch> <yaw>              車両から見たカメラ (光軸が前、水平が 0 0 0)
+//   marker <id> <size> <x> <y> <z> <roll> <pitch> <yaw>  地図上のマーカー (壁に立てて +x を向くのが 0 0 0)
+// 長さは m、角度は度。# 以降はコメント
+struct MarkerMap {
+    Pose3 vehicle_to_camera;            // T_vehicle_camera
+    std::map<int, Pose3> markers;       // T_world_marker
+    std::map<int, double> sizes;        // 一辺 [m] (marker_detect は 0.05 m として tvec を求めている)
+};
+
+bool loadMarkerMap(const std::string& path, MarkerMap& map);
+
+// 1つのマーカーから求めた車両の姿勢
+struct MarkerPoseEstimate {
+    int id;
+    double x, y, theta;
+    double distance;    // カメラからマーカーまで [m]
+};
+
+// rvec/tvec (カメラ座標) から車両の姿勢を求める。地図にないマーカーなら false
+bool vehiclePoseFromMarker(const MarkerMap& map, int id, const double rvec[3], const double tvec[3],
+                           double detected_size, MarkerPoseEstimate& estimate);
+
+// 見えているマーカーの推定をまとめて1つにする。中央値から離れすぎたものは外れ値として捨てる。
+// 戻り値は使ったマーカーの数 (0 なら推定なし)。covariance は (x, y, theta) の 3x3
+int fusePoseEstimates(const std::vector<MarkerPoseEstimate>& estimates, double z[3], double covariance[9]);
+
+// ---- EKF ----
+
+// 状態 [x, y, theta, v, omega]、等速度・等角速度の運動モデル。
+// 観測は fusePoseEstimates の (x, y, theta)
+class VehiclePoseEKF {
+public:
+    static const int N = 5;
+
+    VehiclePoseEKF() : initialized(false), time(0.0), rejected(0) {
+        for (int i = 0; i < N; i++) {
+            s[i] = 0.0;
+            for (int j = 0; j < N; j++) P[i][j] = 0.0;
+        }
+    }
+
+    bool isInitialized() const { return initialized; }
+    double stateTime() const { return time; }
+
+    // 観測 (x, y, theta) を取り込む。t は観測したフレームの取得時刻。
+    // 大きく外れた観測は捨てるが、続けて外れる場合は観測の方を信じて初期化し直す
+    bool update(double t, const double z[3], const double R[9]) {
+        if (!initialized) {
+            reset(t, z, R);
+            return true;
+        }
+        if (t <= time) return false;    // 古いフレーム
+        predict(t - time);
+        time = t;
+
+        double y[3] = {z[0] - s[0], z[1] - s[1], wrapAngle(z[2] - s[2])};
+        double S[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) S[i][j] = P[i][j] + R[i * 3 + j];
+        }
+        double Si[3][3];
+        if (!invert3(S, Si)) return false;
+
+        // マハラノビス距離でゲート (自由度3の 99.7%)
+        double d2 = 0.0;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) d2 += y[i] * Si[i][j] * y[j];
+        }
+        if (d2 > 14.16) {
+            if (++rejected >= MAX_REJECTED) {
+                reset(t, z, R);
+                return true;
+            }
+            return false;
+        }
+        rejected = 0;
+
+        // K = P H^T S^-1 (H は先頭3つの状態を取り出すだけ)
+        double K[N][3];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < 3; j++) {
+                K[i][j] = P[i][0] * Si[0][j] + P[i][1] * Si[1][j] + P[i][2] * Si[2][j];
+            }
+        }
+        for (int i = 0; i < N; i++) s[i] += K[i][0] * y[0] + K[i][1] * y[1] + K[i][2] * y[2];
+        s[2] = wrapAngle(s[2]);
+
+        // P = (I - K H) P
+        double KP[N][N];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) KP[i][j] = K[i][0] * P[0][j] + K[i][1] * P[1][j] + K[i][2] * P[2][j];
+        }
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) P[i][j] -= KP[i][j];
+        }
+        symmetrize();
+        return true;
+    }
+
+    // 状態を t まで外挿した姿勢 (フィルタ自体は進めない)
+    void poseAt(double t, VehiclePose& pose) const {
+        VehiclePoseEKF ahead = *this;
+        if (initialized && t > time) ahead.predict(t - time);
+
+        pose.valid = initialized;
+        pose.x = ahead.s[0];
+        pose.y = ahead.s[1];
+        pose.theta = ahead.s[2];
+        pose.v = ahead.s[3];
+        pose.omega = ahead.s[4];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) pose.covariance[i * 3 + j] = ahead.P[i][j];
+        }
+        pose.timestamp = t;
+        pose.measurement_time = time;
+    }
+
+private:
+    static const int MAX_REJECTED = 5;
+
+    // 加速度・角加速度をノイズとみなす
+    static constexpr double ACCEL_NOISE = 1.0;          // [m/s^2]
+    static constexpr double ANGULAR_ACCEL_NOISE = 2.0;  // [rad/s^2]
+
+    void reset(double t, const double z[3], const double R[9]) {
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) P[i][j] = 0.0;
+        }
+        for (int i = 0; i < 3; i++) {
+            s[i] = z[i];
+            for (int j = 0; j < 3; j++) P[i][j] = R[i * 3 + j];
+        }
+        s[3] = s[4] = 0.0;
+        P[3][3] = 0.5 * 0.5;
+        P[4][4] = 1.0 * 1.0;
+        time = t;
+        rejected = 0;
+        initialized = true;
+    }
+
+    void predict(double dt) {
+        double c = std::cos(s[2]), sn = std::sin(s[2]);
+        double v = s[3];
+
+        s[0] += v * c * dt;
+        s[1] += v * sn * dt;
+        s[2] = wrapAngle(s[2] + s[4] * dt);
+
+        // F = I + [d(x,y)/d(theta, v), d(theta)/d(omega)]
+        double F[N][N] = {{1, 0, -v * sn * dt, c * dt, 0},
+                          {0, 1, v * c * dt, sn * dt, 0},
+                          {0, 0, 1, 0, dt},
+                          {0, 0, 0, 1, 0},
+                          {0, 0, 0, 0, 1}};
+        double FP[N][N];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                FP[i][j] = 0.0;
+                for (int k = 0; k < N; k++) FP[i][j] += F[i][k] * P[k][j];
+            }
+        }
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) {
+                P[i][j] = 0.0;
+                for (int k = 0; k < N; k++) P[i][j] += FP[i][k] * F[j][k];
+            }
+        }
+
+        // 加速度ノイズを速度に入れる (位置への寄与は dt^2 以上なので省略)
+        P[3][3] += ACCEL_NOISE * ACCEL_NOISE * dt;
+        P[4][4] += ANGULAR_ACCEL_NOISE * ANGULAR_ACCEL_NOISE * dt;
+        symmetrize();
+    }
+
+    void symmetrize() {
+        for (int i = 0; i < N; i++) {
+            for (int j = i + 1; j < N; j++) P[i][j] = P[j][i] = 0.5 * (P[i][j] + P[j][i]);
+        }
+    }
+
+    static bool invert3(const double A[3][3], double Ai[3][3]) {
+        double det = A[0][0] * (A[1][1] * A[2][2] - A[1][2] * A[2][1]) -
+                     A[0][1] * (A[1][0] * A[2][2] - A[1][2] * A[2][0]) +
+                     A[0][2] * (A[1][0] * A[2][1] - A[1][1] * A[2][0]);
+        if (std::fabs(det) < 1e-18) return false;
+        double inv = 1.0 / det;
+        Ai[0][0] = (A[1][1] * A[2][2] - A[1][2] * A[2][1]) * inv;
+        Ai[0][1] = (A[0][2] * A[2][1] - A[0][1] * A[2][2]) * inv;
+        Ai[0][2] = (A[0][1] * A[1][2] - A[0][2] * A[1][1]) * inv;
+        Ai[1][0] = (A[1][2] * A[2][0] - A[1][0] * A[2][2]) * inv;
+        Ai[1][1] = (A[0][0] * A[2][2] - A[0][2] * A[2][0]) * inv;
+        Ai[1][2] = (A[0][2] * A[1][0] - A[0][0] * A[1][2]) * inv;
+        Ai[2][0] = (A[1][0] * A[2][1] - A[1][1] * A[2][0]) * inv;
+        Ai[2][1] = (A[0][1] * A[2][0] - A[0][0] * A[2][1]) * inv;
+        Ai[2][2] = (A[0][0] * A[1][1] - A[0][1] * A[1][0]) * inv;
+        return true;
+    }
+
+    bool initialized;
+    double time;        // 状態の時刻 (最後に取り込んだ観測の取得時刻)
+    double s[N];
+    double P[N][N];
+    int rejected;       // 続けてゲートで捨てた観測の数
+};
+
+#endif // VEHICLEPOSE_HPP
@@ -0,0 +1,110 @@
+#include <iostream>
+#include "../include/camera_calibration.h"
+
+CameraIntrinsics defaultIntrinsics(cv::Size imageSize) {
+    CameraIntrinsics intrinsics;
+    double fx = 600.0, fy = 600.0;
+    double cx = imageSize.width / 2.0, cy = imageSize.height / 2.0;
+    intrinsics.camera_matrix = (cv::Mat_<double>(3, 3) << fx, 0, cx, 0, fy, cy, 0, 0, 1);
+    intrinsics.dist_coeffs = cv::Mat::zeros(5, 1, CV_64F);
+    intrinsics.zero_dist = cv::Mat::zeros(5, 1, CV_64F);
+    intrinsics.image_size = imageSize;
+    return intrinsics;
+}
+
+bool loadIntrinsics(const std::string& path, CameraIntrinsics& intrinsics) {
+    cv::FileStorage fs(path, cv::FileStorage::READ);
+    if (!fs.isOpened()) {
+        std::cerr << "エラー: キャリブレーションファイルを開けませんでした: " << path << std::endl;
+        return false;
+    }
+
+    CameraIntrinsics loaded;
+    int width = 0, height = 0;
+    fs["camera_matrix"] >> loaded.camera_matrix;
+    fs["distortion_coefficients"] >> loaded.dist_coeffs;
+    fs["image_width"] >> width;
+    fs["image_height"] >> height;
+
+    if (loaded.camera_matrix.rows != 3 || loaded.camera_matrix.cols != 3 || loaded.dist_coeffs.empty() || width <= 0 || height <= 0) {
+        std::cerr << "エラー: キャリブレーションファイルの形式が不正です: " << path << std::endl;
+        return false;
+    }
+
+    loaded.camera_matrix.convertTo(loaded.camera_matrix, CV_64F);
+    loaded.dist_coeffs.convertTo(loaded.dist_coeffs, CV_64F);
+    loaded.zero_dist = cv::Mat::zeros(5, 1, CV_64F);
+    loaded.image_size = cv::Size(width, height);
+    loaded.calibrated = true;
+    intrinsics = loaded;
+    return true;
+}
+
+bool saveIntrinsics(const std::string& path, const CameraIntrinsics& intrinsics, double rms) {
+    cv::FileStorage fs(path, cv::FileStorage::WRITE);
+    if (!fs.isOpened()) {
+        std::cerr << "エラー: キャリブレーションファイルを書き込めませんでした: " << path << std::endl;
+        return false;
+    }
+    fs << "image_width" << intrinsics.image_size.width;
+    fs << "image_height" << intrinsics.image_size.height;
+    fs << "camera_matrix" << intrinsics.camera_matrix;
+    fs << "distortion_coefficients" << intrinsics.dist_coeffs;
+    fs << "rms_reprojection_error" << rms;
+    return true;
+}
+
+void fitIntrinsics(CameraIntrinsics& intrinsics, cv::Size frameSize) {
+    if (frameSize == intrinsics.image_size || frameSize.width <= 0) return;
+    if (!intrinsics.calibrated) {
+        intrinsics = defaultIntrinsics(frameSize);
+        return;
+    }
+
+    std::cerr << "警告: キャリブレーションの解像度 (" << intrinsics.image_size.width << "x" << intrinsics.image_size.height
+              << ") と取得した解像度 (" << frameSize.width << "x" << frameSize.height << ") が違います。スケーリングして使います。" << std::endl;
+    double sx = (double)frameSize.width / intrinsics.image_size.width;
+    double sy = (double)frameSize.height / intrinsics.image_size.height;
+    cv::Mat K = intrinsics.camera_matrix.clone();
+    K.at<double>(0, 0) *= sx;
+    K.at<double>(0, 2) = (K.at<double>(0, 2) + 0.5) * sx - 0.5;
+    K.at<double>(1, 1) *= sy;
+    K.at<double>(1, 2) = (K.at<double>(1, 2) + 0.5) * sy - 0.5;
+    intrinsics.camera_matrix = K;
+    intrinsics.image_size = frameSize;
+}
+
+void undistortPixels(const CameraIntrinsics& intrinsics, std::vector<cv::Point2f>& points) {
+    if (!intrinsics.calibrated || points.empty()) return;
+    // P = camera_matrix で正規化座標から画素座標に戻す
+    static thread_local std::vector<cv::Point2f> undistorted;
+    cv::undistortPoints(points, undistorted, intrinsics.camera_matrix, intrinsics.dist_coeffs, cv::noArray(), intrinsics.camera_matrix);
+    points.swap(undistorted);
+}
+
+void undistortHumans(const CameraIntrinsics& intrinsics, std::vector<HumanPoseData>& humans) {
+    if (!intrinsics.calibrated || humans.empty()) return;
+
+    // 検出されている肩だけをまとめて1回で補正する
+    static thread_local std::vector<cv::Point2f> points;
+    points.clear();
+    for (const auto& h : humans) {
+        if (h.right_shoulder[0] != -1) points.push_back(cv::Point2f(h.right_shoulder[0], h.right_shoulder[1]));
+        if (h.left_shoulder[0] != -1) points.push_back(cv::Point2f(h.left_shoulder[0], h.left_shoulder[1]));
+    }
+    undistortPixels(intrinsics, points);
+
+    size_t k = 0;
+    for (auto& h : humans) {
+        if (h.right_shoulder[0] != -1) {
+            h.right_shoulder[0] = points[k].x;
+            h.right_shoulder[1] = points[k].y;
+            k++;
+        }
+        if (h.left_shoulder[0] != -1) {
+            h.left_shoulder[0] = points[k].x;
+            h.left_shoulder[1] = points[k].y;
+            k++;
+        }
+    }
+}
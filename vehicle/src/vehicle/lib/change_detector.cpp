@@ -0,0 +1,32 @@
+#include "../include/change_detector.h"
+
+ChangeDetector::ChangeDetector(double threshold, double max_interval)
+    : threshold(threshold), max_interval(max_interval), keyframe_time(0.0), last_difference(0.0) {}
+
+bool ChangeDetector::update(const cv::Mat& image, double now) {
+    if (image.empty()) return true;
+
+    // 色変換は縮小してから行う (フル解像度で触るのは resize の1回だけ)
+    const cv::Mat* small = &image;
+    if (image.size() != GATE_THUMB_SIZE) {
+        cv::resize(image, thumb, GATE_THUMB_SIZE, 0, 0, cv::INTER_AREA);
+        small = &thumb;
+    }
+    if (small->channels() == 3) {
+        cv::cvtColor(*small, gray, cv::COLOR_BGR2GRAY);
+    } else {
+        small->copyTo(gray);
+    }
+
+    bool force = keyframe.empty() || now - keyframe_time >= max_interval;
+    if (!force) {
+        cv::absdiff(gray, keyframe, diff);
+        cv::resize(diff, blocks, GATE_BLOCKS, 0, 0, cv::INTER_AREA);
+        cv::minMaxLoc(blocks, nullptr, &last_difference);
+        if (last_difference < threshold) return false;
+    }
+
+    cv::swap(gray, keyframe);
+    keyframe_time = now;
+    return true;
+}
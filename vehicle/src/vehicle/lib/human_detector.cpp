@@ -0,0 +1,255 @@
+#include <iostream>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/dnn.hpp>
+#include <unistd.h>
+#include "../include/camera_calibration.h"
+#include "../include/change_detector.h"
+#include "../include/human_detector.h"
+#include "../include/human_pose.h"
+#include "../include/human_tracker.h"
+#include "../include/identity_handoff.h"
+#include "../include/mjpeg_decoder.h"
+#include "../include/perception.h"
+#include "../include/pose_worker_pool.h"
+#include "../include/trace.h"
+
+HumanSection humanSection(SharedMemoryData* shared_data, HumanCamera camera) {
+    if (camera == HUMAN_CAMERA_L) {
+        return {"L", &shared_data->human_count_L, shared_data->humans_L,
+                &shared_data->last_human_update_time_L, &shared_data->last_human_capture_time_L};
+    }
+    return {"R", &shared_data->human_count_R, shared_data->humans_R,
+            &shared_data->last_human_update_time_R, &shared_data->last_human_capture_time_R};
+}
+
+void publishHumans(const HumanSection& section, const std::vector<HumanPoseData>& humans,
+                   double timestamp, double capture_timestamp, bool reused) {
+    *section.count = std::min((int)humans.size(), 10);
+    *section.update_time = timestamp;
+    *section.capture_time = capture_timestamp;
+
+    for (int i = 0; i < *section.count; i++) {
+        section.humans[i] = humans[i];
+        section.humans[i].timestamp = timestamp;
+        section.humans[i].capture_timestamp = capture_timestamp;
+        section.humans[i].reused = reused;
+    }
+}
+
+int runHumanDetector(int argc, char** argv, HumanCamera camera) {
+    StartupTimer startup;
+    PerceptionOptions options;
+    if (!parsePerceptionOptions(argc, argv, options)) return -1;
+
+    // 共有メモリの初期化
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(true, shm_fd);
+    if (!shared_data) return -1;
+    HumanSection section = humanSection(shared_data, camera);
+    std::string label = section.name;
+    ProducerId producer = (camera == HUMAN_CAMERA_L) ? PRODUCER_HUMAN_L : PRODUCER_HUMAN_R;
+    applyThreadBudget();
+    installStopHandler();
+
+    TraceRecorder::instance().open(("detect_human" + label).c_str());
+
+    // OpenCV DNNでPose Estimationを行うための準備
+    // OpenPose MobileNetモデル (TensorFlow) を使用
+    std::string modelFile = "graph_opt.pb";
+
+    // モデルファイルの存在確認
+    if (access(modelFile.c_str(), F_OK) == -1) {
+        std::cerr << "エラー: モデルファイルが見つかりません。" << std::endl;
+        std::cerr << "make install を実行してモデルをダウンロードしてください。" << std::endl;
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
+    }
+
+    // フレーム単位で並列化する場合はワーカーごとに Net を持つ (--workers)
+    PoseWorkerPool pool(modelFile, options.workers, options.workers * 2);
+    if (!pool.ok()) {
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
+    }
+    if (pool.workers() > 1) std::cout << "Pose workers: " << pool.workers() << std::endl;
+    startup.phase("model");
+
+    // 最初の数回の推論は遅いので、カメラを開く前にダミーの入力で済ませておく (--warmup)
+    pool.warmUp(options.warmup);
+    startup.phase("warmup");
+
+    // Webカメラを開く
+    cv::VideoCapture cap;
+    if (!openCamera(cap, options.camera)) {
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
+    }
+
+    // MJPEG をデコードせずに受け取る (ワーカーでネットワークの入力の大きさまで縮小デコードする)
+    bool rawMjpeg = options.mjpeg && enableRawMjpeg(cap);
+    if (options.mjpeg && !rawMjpeg) {
+        std::cerr << "警告: MJPEG をそのまま取得できないので、通常の取得に戻します。" << std::endl;
+    }
+    startup.phase("camera");
+
+    // ウィンドウサイズを小さく設定
+    std::string window = "Human Detection " + label;
+    if (!options.headless) {
+        cv::namedWindow(window, cv::WINDOW_NORMAL);
+        cv::resizeWindow(window, 320, 240);
+    }
+
+    // 肩の座標は歪み補正してから追跡・書き込みする (キャリブレーションしていなければそのまま)
+    CameraIntrinsics intrinsics = defaultIntrinsics();
+    if (!options.calibration.empty() && !loadIntrinsics(options.calibration, intrinsics)) {
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
+    }
+
+    registerProducer(shared_data, producer);
+    ProducerMetrics& metrics = shared_data->metrics.producers[producer];
+    FrameDropCounter drops(cap.get(cv::CAP_PROP_FPS));
+
+    // カメラ間のロックの引き継ぎ。既定では L の右端と R の左端が重なっているとする (--overlap)
+    float overlap_min = (camera == HUMAN_CAMERA_L) ? 0.7f : 0.0f;
+    float overlap_max = (camera == HUMAN_CAMERA_L) ? 1.0f : 0.3f;
+    if (options.overlap[0] >= 0) {
+        overlap_min = options.overlap[0];
+        overlap_max = options.overlap[1];
+    }
+    IdentityHandoff handoff(&shared_data->handoff, camera == HUMAN_CAMERA_L ? 0 : 1, overlap_min, overlap_max);
+
+    // フレームをまたいで使い回すバッファ
+    HumanTracker tracker;
+    std::vector<HumanPoseData> trackedHumans;
+    MjpegDecoder displayDecoder;
+    ChangeDetector gate;
+    MjpegDecoder gateDecoder;   // 変化検出用に 1/8 で縮小デコードする
+    cv::Mat gateThumb;
+
+    // 姿勢推定の結果を取得順に受け取り、追跡・書き込み・描画を行う。'q' が押されたら false
+    auto handleResult = [&](PoseJob& job) {
+        const PosePeaks& allPeaks = job.peaks;
+
+        // トラッカー更新 (推論を省いたフレームでは前回の結果をそのまま使う)
+        if (!job.reused) {
+            TraceSpan trackingSpan(TRACE_TRACKING, job.capture_ns);
+            fitIntrinsics(intrinsics, job.frame_size);
+            undistortHumans(intrinsics, job.humans);
+            tracker.update(job.humans, &job.appearances);
+            handoff.update(tracker, job.frame_size, monotonicNow());
+            tracker.getResult(trackedHumans);
+        }
+
+        // 共有メモリへの書き込み (NTPで飛ばないように monotonic clock を使う)
+        TraceSpan publishSpan(TRACE_PUBLISH, job.capture_ns);
+        publishHumans(section, trackedHumans, monotonicNow(), job.capture_ns * 1e-9, job.reused);
+        publishSpan.end();
+        heartbeat(shared_data, producer);
+        if (!shared_data->pipeline.producers[producer].ready) {
+            startup.phase("first_frame");
+            markReady(shared_data, producer, startup);
+        }
+
+        // 壊れたフレーム (推論していない) は取りこぼしとして数える
+        if (job.reused) {
+            metrics.reused.fetch_add(1, std::memory_order_relaxed);
+        } else if (job.forward_ns > 0) {
+            metrics.inference.record(job.forward_ns);
+        } else {
+            metrics.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        metrics.latency.record(monotonicNowNs() - job.capture_ns);
+        metrics.frames.fetch_add(1, std::memory_order_relaxed);
+
+        std::cout << "Detected Humans (" << label << "): " << trackedHumans.size() << " (Locked ID: " << tracker.getLockedId() << ", identity: " << handoff.identity() << ")" << std::endl;
+
+        // 以下は表示用。MJPEG で取得している場合は、ここで初めてフルサイズにデコードする
+        if (options.headless) return true;
+        if (!job.jpeg.empty() && !displayDecoder.decodeFull(job.jpeg, job.frame)) return true;
+        cv::Mat& frame = job.frame;
+        tracker.drawDebug(frame);
+
+        // 描画
+        for (int i = 0; i < *section.count; i++) {
+            cv::Point r(trackedHumans[i].right_shoulder[0], trackedHumans[i].right_shoulder[1]);
+            cv::Point l(trackedHumans[i].left_shoulder[0], trackedHumans[i].left_shoulder[1]);
+
+            if (r.x != -1) {
+                cv::circle(frame, r, 8, cv::Scalar(0, 0, 255), -1);
+                cv::putText(frame, label + std::to_string(i), r, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
+            }
+            if (l.x != -1) {
+                cv::circle(frame, l, 8, cv::Scalar(0, 0, 255), -1);
+                cv::putText(frame, label + std::to_string(i), l, cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255), 1);
+            }
+            if (r.x != -1 && l.x != -1) {
+                cv::line(frame, r, l, cv::Scalar(255, 0, 0), 2);
+            }
+        }
+
+        // 手首の描画 (全検出点)
+        for (const cv::Point p : allPeaks[RIGHT_WRIST]) {
+             cv::line(frame, p, cv::Point(p.x, std::max(0, p.y - 100)), cv::Scalar(0, 255, 255), 2);
+             cv::putText(frame, "Hand", cv::Point(p.x, std::max(10, p.y - 105)), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 1);
+        }
+        for (const cv::Point p : allPeaks[LEFT_WRIST]) {
+             cv::line(frame, p, cv::Point(p.x, std::max(0, p.y - 100)), cv::Scalar(0, 255, 255), 2);
+             cv::putText(frame, "Hand", cv::Point(p.x, std::max(10, p.y - 105)), cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0, 255, 255), 1);
+        }
+
+        cv::imshow(window, frame);
+        return cv::waitKey(1) != 'q';
+    };
+
+    bool quit = false;
+    while (!quit && !stopRequested()) {
+        // 空きがあれば次のフレームを取得してワーカーに渡す
+        PoseJob* job = pool.acquire();
+        if (job) {
+            if (!grabFrame(cap, rawMjpeg ? job->jpeg : job->frame, job->capture_ns)) {
+                pool.release(job);
+                break;
+            }
+            metrics.dropped.fetch_add(drops.update(job->capture_ns), std::memory_order_relaxed);
+
+            // 前に推論したフレームから変わっていなければ推論しない。MJPEG は 1/8 の縮小デコードで比べる
+            // (job->frame は前のジョブのデコード結果なので、縮小デコードに失敗したら比べずに推論する)
+            job->reused = false;
+            if (options.gate) {
+                if (!rawMjpeg) {
+                    job->reused = !gate.update(job->frame, monotonicNow());
+                } else if (gateDecoder.decodeScaled(job->jpeg, GATE_THUMB_SIZE, gateThumb)) {
+                    job->reused = !gate.update(gateThumb, monotonicNow());
+                }
+            }
+            pool.submit(job);
+        }
+        metrics.queue_depth.store((int32_t)pool.inFlight(), std::memory_order_relaxed);
+
+        // 終わったものを取得順に処理する。空きが無ければ最も古いフレームを待つ
+        bool wait = (job == nullptr);
+        while (PoseJob* done = pool.next(wait)) {
+            wait = false;
+            quit = !handleResult(*done);
+            pool.release(done);
+            if (quit) break;
+        }
+    }
+
+    // 録画の終わりや停止のシグナルなど、ループを抜けたら処理中のフレームを片付ける
+    while (!quit) {
+        PoseJob* done = pool.next(true);
+        if (!done) break;
+        quit = !handleResult(*done);
+        pool.release(done);
+    }
+
+    cap.release();
+    if (!options.headless) cv::destroyAllWindows();
+
+    closeSharedMemory(shared_data, shm_fd);
+
+    return 0;
+}
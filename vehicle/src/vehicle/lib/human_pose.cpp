@@ -0,0 +1,156 @@
+#include "../include/human_pose.h"
+
+std::vector<cv::Point> findPeaks(const cv::Mat& heatMap, float threshold) {
+    std::vector<cv::Point> peaks;
+    findPeaks(heatMap, threshold, peaks);
+    return peaks;
+}
+
+void findPeaks(const cv::Mat& heatMap, float threshold, std::vector<cv::Point>& peaks) {
+    peaks.clear();
+    for (int y = 1; y < heatMap.rows - 1; y++) {
+        const float* ptr = heatMap.ptr<float>(y);
+        const float* ptr_up = heatMap.ptr<float>(y - 1);
+        const float* ptr_down = heatMap.ptr<float>(y + 1);
+
+        for (int x = 1; x < heatMap.cols - 1; x++) {
+            float val = ptr[x];
+            if (val > threshold) {
+                if (val >= ptr[x-1] && val >= ptr[x+1] &&
+                    val >= ptr_up[x] && val >= ptr_down[x]) {
+                    peaks.push_back(cv::Point(x, y));
+                }
+            }
+        }
+    }
+}
+
+// 3点 (左, 中央, 右) を通る放物線の頂点のずれ [-0.5, 0.5]
+static float parabolicOffset(float left, float center, float right) {
+    float denom = left - 2.0f * center + right;
+    if (denom >= 0.0f) return 0.0f; // 上に凸でない (平坦など)
+    float offset = 0.5f * (left - right) / denom;
+    return std::max(-0.5f, std::min(0.5f, offset));
+}
+
+cv::Point2f refinePeak(const cv::Mat& heatMap, cv::Point peak) {
+    // findPeaks は端の1画素を除くので、3x3 は常にヒートマップ内に収まる
+    const float* ptr = heatMap.ptr<float>(peak.y);
+    float c = ptr[peak.x];
+    float dx = parabolicOffset(ptr[peak.x - 1], c, ptr[peak.x + 1]);
+    float dy = parabolicOffset(heatMap.ptr<float>(peak.y - 1)[peak.x], c, heatMap.ptr<float>(peak.y + 1)[peak.x]);
+    return cv::Point2f(peak.x + dx, peak.y + dy);
+}
+
+void extractPeaks(const cv::Mat& result, const PoseInput& input, PosePeaks& allPeaks) {
+    int H = result.size[2];
+    int W = result.size[3];
+    float scaleX = (float)input.inputSize().width / W;
+    float scaleY = (float)input.inputSize().height / H;
+
+    // 内側の vector の容量を残したまま空にする
+    allPeaks.resize(POSE_PARTS);
+    static thread_local std::vector<cv::Point> peaks;
+    for (int n = 0; n < POSE_PARTS; n++) {
+        allPeaks[n].clear();
+        cv::Mat heatMap(H, W, CV_32F, const_cast<float*>(result.ptr<float>(0, n)));
+        findPeaks(heatMap, PEAK_THRESHOLD, peaks);
+
+        // サブピクセル化してからネットワーク入力の座標に戻し (セルの中心どうしを対応させる)、
+        // レターボックスを外してフレーム座標にする
+        for (const auto& p : peaks) {
+            cv::Point2f q = refinePeak(heatMap, p);
+            allPeaks[n].push_back(input.toFrame(cv::Point2f((q.x + 0.5f) * scaleX - 0.5f, (q.y + 0.5f) * scaleY - 0.5f)));
+        }
+    }
+}
+
+bool isValidShoulder(const PosePeaks& allPeaks, cv::Point2f shoulder, bool isRight, cv::Size frameSize) {
+    double armDistThresh = frameSize.width / 2.5;
+    double faceDistThresh = frameSize.width / 3.0;
+
+    bool hasArm = false;
+    if (isRight) {
+        for (auto p : allPeaks[RIGHT_ELBOW]) if (cv::norm(shoulder - p) < armDistThresh) hasArm = true;
+        if (!hasArm) for (auto p : allPeaks[RIGHT_WRIST]) if (cv::norm(shoulder - p) < armDistThresh * 1.5) hasArm = true;
+    } else {
+        for (auto p : allPeaks[LEFT_ELBOW]) if (cv::norm(shoulder - p) < armDistThresh) hasArm = true;
+        if (!hasArm) for (auto p : allPeaks[LEFT_WRIST]) if (cv::norm(shoulder - p) < armDistThresh * 1.5) hasArm = true;
+    }
+
+    bool hasFace = false;
+    for (auto p : allPeaks[NECK]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+    if (!hasFace) for (auto p : allPeaks[NOSE]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+    if (!hasFace) for (auto p : allPeaks[RIGHT_EYE]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+    if (!hasFace) for (auto p : allPeaks[LEFT_EYE]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+    if (!hasFace) for (auto p : allPeaks[RIGHT_EAR]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+    if (!hasFace) for (auto p : allPeaks[LEFT_EAR]) if (cv::norm(shoulder - p) < faceDistThresh) hasFace = true;
+
+    return hasArm && hasFace;
+}
+
+void groupHumans(const PosePeaks& allPeaks, cv::Size frameSize, std::vector<HumanPoseData>& detectedHumans) {
+    detectedHumans.clear();
+
+    // 作業用の vector は使い回す
+    static thread_local std::vector<cv::Point2f> rShoulders, lShoulders;
+    static thread_local std::vector<bool> lUsed;
+    rShoulders.clear();
+    lShoulders.clear();
+
+    for (auto p : allPeaks[RIGHT_SHOULDER]) {
+        if (isValidShoulder(allPeaks, p, true, frameSize)) rShoulders.push_back(p);
+    }
+
+    for (auto p : allPeaks[LEFT_SHOULDER]) {
+        if (isValidShoulder(allPeaks, p, false, frameSize)) lShoulders.push_back(p);
+    }
+
+    lUsed.assign(lShoulders.size(), false);
+
+    // 右肩を基準に左肩を探す
+    for (const auto& r : rShoulders) {
+        HumanPoseData human;
+        human.detected = true;
+        human.right_shoulder[0] = r.x;
+        human.right_shoulder[1] = r.y;
+        human.left_shoulder[0] = -1;
+        human.left_shoulder[1] = -1;
+
+        int bestL = -1;
+        double minDesc = 100000; // 大きな値
+
+        for (size_t i = 0; i < lShoulders.size(); i++) {
+            if (lUsed[i]) continue;
+
+            double dist = cv::norm(r - lShoulders[i]);
+            // 肩幅の閾値 (画面サイズによるが、とりあえず適当に)
+            if (dist < frameSize.width / 2) {
+                if (dist < minDesc) {
+                    minDesc = dist;
+                    bestL = i;
+                }
+            }
+        }
+
+        if (bestL != -1) {
+            human.left_shoulder[0] = lShoulders[bestL].x;
+            human.left_shoulder[1] = lShoulders[bestL].y;
+            lUsed[bestL] = true;
+        }
+        detectedHumans.push_back(human);
+    }
+
+    // 使われなかった左肩を別の人間として追加
+    for (size_t i = 0; i < lShoulders.size(); i++) {
+        if (!lUsed[i]) {
+            HumanPoseData human;
+            human.detected = true;
+            human.right_shoulder[0] = -1;
+            human.right_shoulder[1] = -1;
+            human.left_shoulder[0] = lShoulders[i].x;
+            human.left_shoulder[1] = lShoulders[i].y;
+            detectedHumans.push_back(human);
+        }
+    }
+}
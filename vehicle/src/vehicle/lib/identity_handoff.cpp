@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "../include/identity_handoff.h"
+
+const int APPEARANCE_BINS = APPEARANCE_H_BINS * APPEARANCE_S_BINS;
+const int MIN_TORSO_PIXELS = 64;
+
+void torsoAppearance(const cv::Mat& image, cv::Size frameSize, const HumanPoseData& human, TorsoAppearance& appearance) {
+    appearance.valid = false;
+    if (human.right_shoulder[0] == -1 || human.left_shoulder[0] == -1 || frameSize.width <= 0) return;
+
+    // 両肩の間を幅とし、肩から下に肩幅の 1.2 倍までを胴体とする
+    double scale = (double)image.cols / frameSize.width;
+    double x0 = std::min(human.right_shoulder[0], human.left_shoulder[0]) * scale;
+    double x1 = std::max(human.right_shoulder[0], human.left_shoulder[0]) * scale;
+    double y0 = std::max(human.right_shoulder[1], human.left_shoulder[1]) * scale;
+    double y1 = y0 + (x1 - x0) * 1.2;
+    cv::Rect torso((int)x0, (int)y0, (int)(x1 - x0), (int)(y1 - y0));
+    torso &= cv::Rect(0, 0, image.cols, image.rows);
+    if (torso.area() < MIN_TORSO_PIXELS) return;
+
+    static thread_local cv::Mat hsv;
+    cv::cvtColor(image(torso), hsv, cv::COLOR_BGR2HSV);
+
+    // H は 0〜179、S は 0〜255
+    int counts[APPEARANCE_BINS] = {0};
+    for (int y = 0; y < hsv.rows; y++) {
+        const uint8_t* row = hsv.ptr<uint8_t>(y);
+        for (int x = 0; x < hsv.cols; x++) {
+            int h = row[x * 3] * APPEARANCE_H_BINS / 180;
+            int s = row[x * 3 + 1] * APPEARANCE_S_BINS / 256;
+            counts[std::min(h, APPEARANCE_H_BINS - 1) * APPEARANCE_S_BINS + s]++;
+        }
+    }
+    float total = (float)(hsv.rows * hsv.cols);
+    for (int i = 0; i < APPEARANCE_BINS; i++) appearance.hist[i] = counts[i] / total;
+    appearance.valid = true;
+}
+
+float appearanceDistance(const TorsoAppearance& a, const TorsoAppearance& b) {
+    if (!a.valid || !b.valid) return 1.0f;
+    float bc = 0.0f;
+    for (int i = 0; i < APPEARANCE_BINS; i++) bc += std::sqrt(a.hist[i] * b.hist[i]);
+    return std::sqrt(std::max(0.0f, 1.0f - bc));
+}
+
+IdentityHandoff::IdentityHandoff(IdentityHandoffData* shared, int camera, float overlap_min, float overlap_max)
+    : shared(shared), camera(camera), overlap_min(overlap_min), overlap_max(overlap_max),
+      locked_track(-1), current_identity(0) {}
+
+bool IdentityHandoff::inOverlap(const TrackedHuman& track, cv::Size frameSize) const {
+    float x = track.center.x / frameSize.width;
+    return x >= overlap_min && x <= overlap_max;
+}
+
+bool IdentityHandoff::recentOtherTarget(double now, HandoffTarget& target) const {
+    if (!shared->cameras[1 - camera].read(target)) return false;
+    return target.identity != 0 && target.in_overlap && target.appearance.valid &&
+           now - target.last_seen <= HANDOFF_WINDOW;
+}
+
+void IdentityHandoff::publish(const TrackedHuman& track, cv::Size frameSize, double now) {
+    HandoffTarget target;
+    target.identity = current_identity;
+    target.last_seen = now;
+    target.x = track.center.x / frameSize.width;
+    target.y = track.center.y / frameSize.height;
+    target.in_overlap = inOverlap(track, frameSize);
+    target.appearance = track.appearance;
+    shared->cameras[camera].write(target);
+}
+
+void IdentityHandoff::update(HumanTracker& tracker, cv::Size frameSize, double now) {
+    HandoffTarget other;
+    const TrackedHuman* locked = tracker.lockedTrack();
+
+    if (locked) {
+        if (locked->id != locked_track) {
+            // 自分で新しくロックした。もう一方のカメラが同じ人物を見ていれば ID を揃える
+            locked_track = locked->id;
+            if (recentOtherTarget(now, other) && inOverlap(*locked, frameSize) &&
+                appearanceDistance(locked->appearance, other.appearance) <= HANDOFF_MAX_DISTANCE) {
+                current_identity = other.identity;
+            } else {
+                current_identity = shared->last_identity.fetch_add(1) + 1;
+            }
+        }
+        // 見えなくなっている間は last_seen を進めない
+        if (locked->missing_frames == 0) publish(*locked, frameSize, now);
+        return;
+    }
+
+    locked_track = -1;
+    current_identity = 0;
+    if (!recentOtherTarget(now, other)) return;
+
+    // 重なりの範囲に現れたばかりの人物のうち、色が最も近いもの
+    const TrackedHuman* best = nullptr;
+    float best_distance = HANDOFF_MAX_DISTANCE;
+    for (const auto& track : tracker.getTracks()) {
+        if (track.missing_frames > 0 || track.consecutive_frames < HANDOFF_LOCK_FRAMES) continue;
+        if (!inOverlap(track, frameSize)) continue;
+        float distance = appearanceDistance(track.appearance, other.appearance);
+        if (distance <= best_distance) {
+            best_distance = distance;
+            best = &track;
+        }
+    }
+    if (!best) return;
+
+    tracker.lock(best->id);
+    locked_track = best->id;
+    current_identity = other.identity;
+    publish(*best, frameSize, now);
+    std::cout << "Handoff: identity " << current_identity << " -> track " << best->id
+              << " (distance " << best_distance << ")" << std::endl;
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cmath>
+#include "../include/marker_pose.h"
+
+MarkerPoseEstimator::MarkerPoseEstimator(double marker_length, double max_age)
+    : max_age(max_age), warm_started(0) {
+    // SOLVEPNP_IPPE_SQUARE が要求する順番 (estimatePoseSingleMarkers と同じ)
+    float h = (float)(marker_length / 2.0);
+    object_points = {cv::Point3f(-h, h, 0), cv::Point3f(h, h, 0), cv::Point3f(h, -h, 0), cv::Point3f(-h, -h, 0)};
+}
+
+// 4つの角の再投影誤差 (RMS)
+static double reprojectionError(const std::vector<cv::Point3f>& object_points, const std::vector<cv::Point2f>& corners,
+                                const cv::Mat& camera_matrix, const cv::Vec3d& rvec, const cv::Vec3d& tvec) {
+    std::vector<cv::Point2f> projected;
+    cv::projectPoints(object_points, rvec, tvec, camera_matrix, cv::noArray(), projected);
+    double sum = 0.0;
+    for (size_t i = 0; i < corners.size(); i++) {
+        cv::Point2f d = projected[i] - corners[i];
+        sum += d.x * d.x + d.y * d.y;
+    }
+    return std::sqrt(sum / corners.size());
+}
+
+void MarkerPoseEstimator::estimate(const std::vector<std::vector<cv::Point2f>>& corners, const std::vector<int>& ids,
+                                   const cv::Mat& camera_matrix, double now,
+                                   std::vector<cv::Vec3d>& rvecs, std::vector<cv::Vec3d>& tvecs) {
+    size_t n = std::min(corners.size(), ids.size());
+    rvecs.resize(n);
+    tvecs.resize(n);
+    guesses.assign(n, nullptr);
+    warm.assign(n, 0);
+
+    // 初期値は並列に解く前に引いておく (ループの中では previous を触らない)
+    for (size_t i = 0; i < n; i++) {
+        CV_Assert(corners[i].size() == 4); // detectMarkers の結果は必ず4つの角
+        auto it = previous.find(ids[i]);
+        if (it != previous.end() && now - it->second.time <= max_age) guesses[i] = &it->second;
+    }
+
+    cv::parallel_for_(cv::Range(0, (int)n), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            if (guesses[i]) {
+                rvecs[i] = guesses[i]->rvec;
+                tvecs[i] = guesses[i]->tvec;
+                if (cv::solvePnP(object_points, corners[i], camera_matrix, cv::noArray(), rvecs[i], tvecs[i],
+                                 true, cv::SOLVEPNP_ITERATIVE) &&
+                    tvecs[i][2] > 0 &&
+                    reprojectionError(object_points, corners[i], camera_matrix, rvecs[i], tvecs[i]) <= MARKER_WARM_START_ERROR) {
+                    warm[i] = 1;
+                    continue;
+                }
+            }
+            cv::solvePnP(object_points, corners[i], camera_matrix, cv::noArray(), rvecs[i], tvecs[i],
+                         false, cv::SOLVEPNP_IPPE_SQUARE);
+        }
+    });
+
+    warm_started = 0;
+    for (size_t i = 0; i < n; i++) {
+        warm_started += warm[i];
+        previous[ids[i]] = {rvecs[i], tvecs[i], now};
+    }
+
+    // 見えなくなった ID を捨てる (辞書の ID の数までしか増えないが、古い初期値を残さない)
+    for (auto it = previous.begin(); it != previous.end();) {
+        if (now - it->second.time > max_age) {
+            it = previous.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
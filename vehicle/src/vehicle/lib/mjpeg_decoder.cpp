@@ -0,0 +1,54 @@
+#include <iostream>
+#include <turbojpeg.h>
+#include "../include/mjpeg_decoder.h"
+
+MjpegDecoder::MjpegDecoder() : handle(tjInitDecompress()) {}
+
+MjpegDecoder::~MjpegDecoder() {
+    if (handle) tjDestroy(handle);
+}
+
+bool MjpegDecoder::readSize(const cv::Mat& jpeg, cv::Size& size) {
+    int width, height, subsamp, colorspace;
+    if (!handle || tjDecompressHeader3(handle, jpeg.ptr<unsigned char>(), jpeg.total(), &width, &height, &subsamp, &colorspace) != 0) {
+        return false;
+    }
+    size = cv::Size(width, height);
+    return true;
+}
+
+bool MjpegDecoder::decodeScaled(const cv::Mat& jpeg, cv::Size target, cv::Mat& bgr) {
+    cv::Size full;
+    if (!readSize(jpeg, full)) return false;
+
+    // 1/8 から順に、target を覆う最初の縮小率を使う
+    int denom = 1;
+    for (int d = 8; d > 1; d /= 2) {
+        int w = (full.width + d - 1) / d, h = (full.height + d - 1) / d;
+        if (w >= target.width || h >= target.height) {
+            denom = d;
+            break;
+        }
+    }
+    return decode(jpeg, full, denom, bgr);
+}
+
+bool MjpegDecoder::decodeFull(const cv::Mat& jpeg, cv::Mat& bgr) {
+    cv::Size full;
+    return readSize(jpeg, full) && decode(jpeg, full, 1, bgr);
+}
+
+bool MjpegDecoder::decode(const cv::Mat& jpeg, cv::Size full, int scale_denom, cv::Mat& bgr) {
+    tjscalingfactor factor = {1, scale_denom};
+    int width = TJSCALED(full.width, factor);
+    int height = TJSCALED(full.height, factor);
+    bgr.create(height, width, CV_8UC3);   // 同じ大きさなら確保し直さない
+
+    // 幅・高さに縮小後の値を渡すと、その大きさになるスケーリングで IDCT する
+    if (tjDecompress2(handle, jpeg.ptr<unsigned char>(), jpeg.total(), bgr.ptr<unsigned char>(), width, (int)bgr.step,
+                      height, TJPF_BGR, TJFLAG_FASTDCT) != 0) {
+        // 途中が壊れているフレーム (USB の取りこぼしなど) は警告だけ出して使う
+        if (tjGetErrorCode(handle) != TJERR_WARNING) return false;
+    }
+    return true;
+}
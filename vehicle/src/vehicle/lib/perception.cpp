@@ -0,0 +1,212 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include "../include/perception.h"
+#include "../include/trace.h"
+
+bool parsePerceptionOptions(int argc, char** argv, PerceptionOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--mjpeg") {
+            options.mjpeg = true;
+        } else if (arg == "--luma") {
+            options.luma = true;
+        } else if (arg == "--gate") {
+            options.gate = true;
+        } else if (arg == "--overlap" && i + 1 < argc) {
+            // 例: --overlap 0.7,1.0
+            if (sscanf(argv[++i], "%f,%f", &options.overlap[0], &options.overlap[1]) != 2 ||
+                options.overlap[0] < 0 || options.overlap[0] >= options.overlap[1]) {
+                options.camera.clear();
+                break;
+            }
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--calib" && i + 1 < argc) {
+            options.calibration = argv[++i];
+        } else if (arg == "--workers" && i + 1 < argc) {
+            options.workers = std::atoi(argv[++i]);
+            if (options.workers < 1) {
+                options.camera.clear();
+                break;
+            }
+        } else if (options.camera.empty() && arg.compare(0, 2, "--") != 0) {
+            options.camera = arg;
+        } else {
+            options.camera.clear();
+            break;
+        }
+    }
+
+    if (options.camera.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--headless] [--calib <file>] [--workers N] [--warmup N] [--mjpeg] [--luma] [--gate] [--overlap x0,x1] <camera_path_or_id>" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool openCamera(cv::VideoCapture& cap, const std::string& camera) {
+    if (std::all_of(camera.begin(), camera.end(), ::isdigit)) {
+        cap.open(std::stoi(camera), cv::CAP_V4L2);
+    } else if (camera.compare(0, 5, "/dev/") != 0 && access(camera.c_str(), F_OK) == 0) {
+        // 録画ファイル (V4L2 では開けない)
+        cap.open(camera, cv::CAP_ANY);
+    } else {
+        cap.open(camera, cv::CAP_V4L2);
+    }
+
+    if (!cap.isOpened()) {
+        std::cerr << "エラー: カメラを開けませんでした。" << std::endl;
+        return false;
+    }
+    std::cout << "Camera backend: " << cap.getBackendName() << std::endl;
+    return true;
+}
+
+bool enableRawMjpeg(cv::VideoCapture& cap) {
+    const int mjpg = cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+    cap.set(cv::CAP_PROP_FOURCC, mjpg);
+    if ((int)cap.get(cv::CAP_PROP_FOURCC) != mjpg) return false;
+    // CAP_PROP_FORMAT = -1 で変換を止める (V4L2 バックエンドのみ)
+    return cap.set(cv::CAP_PROP_FORMAT, -1);
+}
+
+bool enableRawYuyv(cv::VideoCapture& cap) {
+    const int yuyv = cv::VideoWriter::fourcc('Y', 'U', 'Y', 'V');
+    cap.set(cv::CAP_PROP_FOURCC, yuyv);
+    if ((int)cap.get(cv::CAP_PROP_FOURCC) != yuyv) return false;
+    return cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
+}
+
+bool wrapYuyv(const cv::Mat& raw, cv::Size size, cv::Mat& yuyv) {
+    if (raw.empty() || size.width <= 0 || size.height <= 0) return false;
+    if (raw.type() == CV_8UC2 && raw.size() == size) {
+        yuyv = raw;
+        return true;
+    }
+    // 1 x N のバイト列。1行のバイト数は N / 高さ (詰め物を含む)
+    size_t bytes = raw.total() * raw.elemSize();
+    if (raw.type() != CV_8UC1 || !raw.isContinuous() || bytes % size.height != 0) return false;
+    size_t step = bytes / size.height;
+    if (step < (size_t)size.width * 2) return false;
+    yuyv = cv::Mat(size, CV_8UC2, raw.data, step);
+    return true;
+}
+
+SharedMemoryData* openSharedMemory(bool writable, int& shm_fd) {
+    shm_fd = shm_open(SHM_NAME, writable ? (O_CREAT | O_RDWR) : O_RDONLY, 0666);
+    if (shm_fd == -1) {
+        if (writable) {
+            std::cerr << "エラー: 共有メモリを作成できませんでした。" << std::endl;
+        } else {
+            std::cerr << "エラー: 共有メモリを開けませんでした。detect_humanL/R または marker_detect を先に実行してください。" << std::endl;
+        }
+        return nullptr;
+    }
+
+    // 共有メモリのサイズを設定
+    if (writable && ftruncate(shm_fd, sizeof(SharedMemoryData)) == -1) {
+        std::cerr << "エラー: 共有メモリのサイズを設定できませんでした。" << std::endl;
+        close(shm_fd);
+        return nullptr;
+    }
+
+    // 共有メモリをマッピング
+    void* p = mmap(nullptr, sizeof(SharedMemoryData), writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                   MAP_SHARED, shm_fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "エラー: 共有メモリをマッピングできませんでした。" << std::endl;
+        close(shm_fd);
+        return nullptr;
+    }
+    return reinterpret_cast<SharedMemoryData*>(p);
+}
+
+void closeSharedMemory(SharedMemoryData* shared_data, int shm_fd) {
+    munmap(shared_data, sizeof(SharedMemoryData));
+    close(shm_fd);
+    // NOTE: shm_unlink is not called here to avoid removing the shared memory segment
+    // while other processes might still be using it. Cleanup should be handled separately.
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void onStopSignal(int) { stop_requested = 1; }
+
+void installStopHandler() {
+    // SA_RESTART を付けないので、ブロックしている読み込みも EINTR で戻る
+    struct sigaction action{};
+    action.sa_handler = onStopSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+bool stopRequested() { return stop_requested != 0; }
+
+void applyThreadBudget() {
+    const char* threads = getenv("VEHICLE_CV_THREADS");
+    if (!threads) return;
+    int n = std::atoi(threads);
+    if (n > 0) cv::setNumThreads(n);
+}
+
+const char* producerName(ProducerId id) {
+    static const char* names[PRODUCER_COUNT] = {"marker", "human_L", "human_R", "serial_mux", "vehicle_pose"};
+    return id < PRODUCER_COUNT ? names[id] : "unknown";
+}
+
+void registerProducer(SharedMemoryData* shared_data, ProducerId id) {
+    ProducerStatus& status = shared_data->pipeline.producers[id];
+    status.ready = false;
+    status.heartbeat = monotonicNow();
+    status.pid = getpid();
+}
+
+void heartbeat(SharedMemoryData* shared_data, ProducerId id) {
+    shared_data->pipeline.producers[id].heartbeat = monotonicNow();
+}
+
+StartupTimer::StartupTimer() : begin_ns(monotonicNowNs()), last_ns(begin_ns) {}
+
+void StartupTimer::phase(const char* name) {
+    int64_t now = monotonicNowNs();
+    phases.emplace_back(name, (now - last_ns) / 1e6);
+    last_ns = now;
+}
+
+double StartupTimer::totalMs() const {
+    return (last_ns - begin_ns) / 1e6;
+}
+
+std::string StartupTimer::summary() const {
+    std::string text;
+    for (const auto& phase : phases) {
+        text += phase.first + " " + std::to_string((int)(phase.second + 0.5)) + " ms, ";
+    }
+    return text + "(total " + std::to_string((int)(totalMs() + 0.5)) + " ms)";
+}
+
+void markReady(SharedMemoryData* shared_data, ProducerId id, const StartupTimer& startup) {
+    ProducerStatus& status = shared_data->pipeline.producers[id];
+    status.startup_ms = (float)startup.totalMs();
+    status.ready = true;
+    std::cout << "Ready (" << producerName(id) << "): " << startup.summary() << std::endl;
+}
+
+bool grabFrame(cv::VideoCapture& cap, cv::Mat& frame, int64_t& capture_ns) {
+    int64_t grab_begin_ns = monotonicNowNs();
+    if (!cap.grab()) return false;
+    capture_ns = monotonicNowNs();
+    cap.retrieve(frame);
+    TraceRecorder::instance().record(TRACE_CAPTURE, grab_begin_ns, monotonicNowNs(), capture_ns);
+    return !frame.empty();
+}
@@ -0,0 +1,206 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/perf_counters.h"
+#include "../include/trace.h"
+
+static_assert(TRACE_STAGE_COUNT <= PERF_MAX_STAGES, "PERF_MAX_STAGES を増やしてください");
+
+const char* perfCounterName(int counter) {
+    static const char* names[PERF_COUNTER_COUNT] = {
+        "cycles", "instructions", "L1d-misses", "LLC-misses", "branch-misses", "context-switches"};
+    return counter >= 0 && counter < PERF_COUNTER_COUNT ? names[counter] : "unknown";
+}
+
+struct CounterConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+static const uint64_t CACHE_READ_MISS = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+// PerfCounter と同じ順。ハードウェアのカウンタを先に開き、グループのリーダーにする
+static const CounterConfig COUNTER_CONFIGS[PERF_COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | CACHE_READ_MISS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | CACHE_READ_MISS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+static int perfEventOpen(const CounterConfig& counter, int group, bool excludeKernel) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter.type;
+    attr.config = counter.config;
+    attr.exclude_kernel = excludeKernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // pid = 0, cpu = -1: 呼んだスレッドをどの CPU にいても数える
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+// スレッドごとのカウンタのグループ。1回の read() で全部読む
+struct ThreadCounters {
+    bool opened = false;
+    int leader = -1;
+    int fds[PERF_COUNTER_COUNT];
+    int order[PERF_COUNTER_COUNT];  // read() で返る順 → PerfCounter
+    int count = 0;
+
+    void open(std::atomic<uint32_t>& available) {
+        opened = true;
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+            // perf_event_paranoid が 2 以上だとカーネル側は数えられないので、ユーザー空間だけで開き直す
+            int fd = perfEventOpen(COUNTER_CONFIGS[c], leader, false);
+            if (fd == -1 && (errno == EACCES || errno == EPERM)) fd = perfEventOpen(COUNTER_CONFIGS[c], leader, true);
+            if (fd == -1) continue;
+            if (leader == -1) leader = fd;
+            fds[count] = fd;
+            order[count] = c;
+            count++;
+            available.fetch_or(1u << c, std::memory_order_relaxed);
+        }
+    }
+
+    bool read(PerfSample& sample) {
+        uint64_t buf[3 + PERF_COUNTER_COUNT];
+        size_t size = (3 + count) * sizeof(uint64_t);
+        if (leader == -1 || ::read(leader, buf, size) != (ssize_t)size) return false;
+        sample.enabled = buf[1];
+        sample.running = buf[2];
+        for (int i = 0; i < count; i++) sample.values[order[i]] = buf[3 + i];
+        return true;
+    }
+
+    ~ThreadCounters() {
+        for (int i = 0; i < count; i++) close(fds[i]);
+    }
+};
+
+static thread_local ThreadCounters threadCounters;
+
+void PerfCounters::open(const char* process) {
+    if (block || !getenv("VEHICLE_PERF")) return;
+
+    shm_name = std::string(PERF_SHM_PREFIX) + process;
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd == -1) return;
+    if (ftruncate(fd, sizeof(PerfBlock)) == -1) {
+        close(fd);
+        return;
+    }
+    void* p = mmap(nullptr, sizeof(PerfBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return;
+
+    PerfBlock* b = static_cast<PerfBlock*>(p);
+    memset(static_cast<void*>(b), 0, sizeof(PerfBlock));
+    b->pid = getpid();
+    strncpy(b->process, process, sizeof(b->process) - 1);
+    b->magic = PERF_MAGIC;
+
+    // このスレッドで開けなければ他のスレッドでも開けないので、ここで確かめておく
+    threadCounters.open(b->available);
+    if (b->available.load() == 0) {
+        std::cerr << "警告: ハードウェアカウンタを開けませんでした (perf_event_paranoid を確認してください)。区間の時間だけを集計します。" << std::endl;
+    }
+    block = b;
+}
+
+void PerfCounters::begin(PerfSample& sample) {
+    if (!block) return;
+    if (!threadCounters.opened) threadCounters.open(block->available);
+    sample.begin_ns = monotonicNowNs();
+    sample.valid = threadCounters.read(sample);
+}
+
+void PerfCounters::end(uint32_t stage, const PerfSample& sample) {
+    if (!block || stage >= PERF_MAX_STAGES) return;
+    PerfStageTotals& totals = block->stages[stage];
+    totals.spans.fetch_add(1, std::memory_order_relaxed);
+    totals.time_ns.fetch_add(monotonicNowNs() - sample.begin_ns, std::memory_order_relaxed);
+
+    PerfSample now;
+    if (!sample.valid || !threadCounters.read(now)) return;
+    uint64_t enabled = now.enabled - sample.enabled;
+    uint64_t running = now.running - sample.running;
+    if (running == 0) {
+        totals.unscheduled.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // 多重化で一部の時間しか数えていなければ、数えた時間の割合で割り戻す
+    double scale = (double)enabled / running;
+    uint32_t available = block->available.load(std::memory_order_relaxed);
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        if (!(available & (1u << c))) continue;
+        totals.values[c].fetch_add((uint64_t)((now.values[c] - sample.values[c]) * scale), std::memory_order_relaxed);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    if (!block) return;
+    std::cout << "---- perf counters (" << block->process << ") ----" << std::endl;
+    printPerfSummary(*block, std::cout);
+    munmap(block, sizeof(PerfBlock));
+}
+
+void printPerfSummary(const PerfBlock& block, std::ostream& out) {
+    uint32_t available = block.available.load(std::memory_order_relaxed);
+    auto has = [&](PerfCounter c) { return (available & (1u << c)) != 0; };
+
+    out << std::left << std::setw(12) << "stage" << std::right
+        << std::setw(10) << "spans" << std::setw(10) << "ms/span" << std::setw(12) << "Mcyc/span"
+        << std::setw(7) << "IPC" << std::setw(10) << "L1d/kI" << std::setw(10) << "LLC/kI"
+        << std::setw(10) << "br/kI" << std::setw(9) << "cs/span" << std::setw(8) << "unsch" << std::endl;
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed;
+    for (uint32_t stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+        const PerfStageTotals& t = block.stages[stage];
+        uint64_t spans = t.spans.load(std::memory_order_relaxed);
+        if (spans == 0) continue;
+        uint64_t counted = spans - t.unscheduled.load(std::memory_order_relaxed);
+        double v[PERF_COUNTER_COUNT];
+        for (int c = 0; c < PERF_COUNTER_COUNT; c++) v[c] = (double)t.values[c].load(std::memory_order_relaxed);
+        double kilo_instructions = v[PERF_INSTRUCTIONS] / 1000.0;
+
+        // 求められない値は "-"
+        auto cell = [&](bool ok, double value, int width, int precision) {
+            if (ok) {
+                out << std::setw(width) << std::setprecision(precision) << value;
+            } else {
+                out << std::setw(width) << "-";
+            }
+        };
+        bool perSpan = counted > 0;
+        bool perInstr = has(PERF_INSTRUCTIONS) && kilo_instructions > 0;
+
+        out << std::left << std::setw(12) << traceStageName(stage) << std::right << std::setw(10) << spans;
+        cell(true, t.time_ns.load(std::memory_order_relaxed) / 1e6 / spans, 10, 3);
+        cell(perSpan && has(PERF_CYCLES), v[PERF_CYCLES] / 1e6 / counted, 12, 3);
+        cell(has(PERF_CYCLES) && perInstr && v[PERF_CYCLES] > 0, v[PERF_INSTRUCTIONS] / v[PERF_CYCLES], 7, 2);
+        cell(perInstr && has(PERF_L1D_MISSES), v[PERF_L1D_MISSES] / kilo_instructions, 10, 2);
+        cell(perInstr && has(PERF_LLC_MISSES), v[PERF_LLC_MISSES] / kilo_instructions, 10, 2);
+        cell(perInstr && has(PERF_BRANCH_MISSES), v[PERF_BRANCH_MISSES] / kilo_instructions, 10, 2);
+        cell(perSpan && has(PERF_CONTEXT_SWITCHES), v[PERF_CONTEXT_SWITCHES] / counted, 9, 2);
+        out << std::setw(8) << spans - counted << std::endl;
+    }
+    out.flags(flags);
+
+    out << "counters:";
+    for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+        out << " " << perfCounterName(c) << (has((PerfCounter)c) ? "" : "(n/a)");
+    }
+    out << std::endl;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cmath>
+#include "../include/pose_input.h"
+
+// 参照元のPythonコードに合わせて scale=1.0, mean=127.5
+const float INPUT_MEAN = 127.5f;
+
+PoseInput::PoseInput(cv::Size inputSize)
+    : input(inputSize), frame_size(0, 0), scale(1.0f), pad_x(0), pad_y(0), original_x(1.0f), original_y(1.0f) {
+    int sz[] = {1, 3, input.height, input.width};
+    tensor.create(4, sz, CV_32F);
+}
+
+void PoseInput::configure(cv::Size frameSize) {
+    frame_size = frameSize;
+    scale = std::min((float)input.width / frameSize.width, (float)input.height / frameSize.height);
+
+    int w = std::min(input.width, (int)std::lround(frameSize.width * scale));
+    int h = std::min(input.height, (int)std::lround(frameSize.height * scale));
+    pad_x = (input.width - w) / 2;
+    pad_y = (input.height - h) / 2;
+    content = cv::Rect(pad_x, pad_y, w, h);
+
+    // 余白は平均値 (減算後は 0)。毎フレーム書き込むのは content の中だけ
+    tensor.setTo(cv::Scalar(0));
+
+    // 画素の中心どうしを対応させる: src = (dst + 0.5) / scale - 0.5
+    auto table = [&](int n, int srcSize, std::vector<int>& i0, std::vector<int>& i1, std::vector<float>& weight, int stride) {
+        i0.resize(n);
+        i1.resize(n);
+        weight.resize(n);
+        for (int i = 0; i < n; i++) {
+            float src = std::max(0.0f, (i + 0.5f) / scale - 0.5f);
+            int a = std::min((int)src, srcSize - 1);
+            int b = std::min(a + 1, srcSize - 1);
+            i0[i] = a * stride;
+            i1[i] = b * stride;
+            weight[i] = std::min(1.0f, src - a);
+        }
+    };
+    table(w, frameSize.width, src_x0, src_x1, weight_x, 3);
+    table(h, frameSize.height, src_y0, src_y1, weight_y, 1);
+}
+
+void PoseInput::set(const cv::Mat& frame, cv::Size originalSize) {
+    CV_Assert(frame.type() == CV_8UC3);
+    if (frame.cols != frame_size.width || frame.rows != frame_size.height) configure(cv::Size(frame.cols, frame.rows));
+    original_x = originalSize.width > 0 ? (float)originalSize.width / frame.cols : 1.0f;
+    original_y = originalSize.height > 0 ? (float)originalSize.height / frame.rows : 1.0f;
+
+    const int plane = input.width * input.height;
+    float* outR = tensor.ptr<float>();
+    float* outG = outR + plane;
+    float* outB = outG + plane;
+
+    for (int j = 0; j < content.height; j++) {
+        const uchar* row0 = frame.ptr<uchar>(src_y0[j]);
+        const uchar* row1 = frame.ptr<uchar>(src_y1[j]);
+        const float fy = weight_y[j];
+        const int offset = (content.y + j) * input.width + content.x;
+        float* r = outR + offset;
+        float* g = outG + offset;
+        float* b = outB + offset;
+
+        for (int i = 0; i < content.width; i++) {
+            const int x0 = src_x0[i], x1 = src_x1[i];
+            const float fx = weight_x[i];
+            float v[3];
+            for (int c = 0; c < 3; c++) {
+                float top = row0[x0 + c] + (row0[x1 + c] - row0[x0 + c]) * fx;
+                float bottom = row1[x0 + c] + (row1[x1 + c] - row1[x0 + c]) * fx;
+                v[c] = top + (bottom - top) * fy - INPUT_MEAN;
+            }
+            // BGR -> RGB
+            b[i] = v[0];
+            g[i] = v[1];
+            r[i] = v[2];
+        }
+    }
+}
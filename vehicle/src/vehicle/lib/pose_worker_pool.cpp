@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/identity_handoff.h"
+#include "../include/mjpeg_decoder.h"
+#include "../include/pose_worker_pool.h"
+#include "../include/trace.h"
+
+cv::dnn::Net loadPoseNet(const char* data, size_t size) {
+    cv::dnn::Net net = cv::dnn::readNetFromTensorflow(data, size);
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    return net;
+}
+
+void warmUpPoseNet(cv::dnn::Net& net, int count) {
+    if (count <= 0) return;
+    // 灰色一色の画像 (前処理の後はほぼゼロ) を入力にする
+    PoseInput input;
+    input.set(cv::Mat(input.inputSize(), CV_8UC3, cv::Scalar(128, 128, 128)));
+    for (int i = 0; i < count; i++) {
+        net.setInput(input.blob());
+        net.forward();
+    }
+}
+
+// 読み込みの間だけモデルファイルを mmap しておく (Net は読み込んだ内容を自分で持つ)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) : data(nullptr), size(0) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, st.st_size, MADV_WILLNEED);
+                data = static_cast<const char*>(p);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data;
+    size_t size;
+};
+
+void runPoseJob(cv::dnn::Net& net, PoseJob& job) {
+    // MJPEG はネットワークの入力に必要な大きさまでしかデコードしない
+    const cv::Mat* image = &job.frame;
+    job.forward_ns = 0;
+    if (job.reused) {
+        // 結果は前のフレームのものを使う (使い回しているジョブの古い結果は消しておく)
+        job.peaks.assign(POSE_PARTS, std::vector<cv::Point2f>());
+        job.humans.clear();
+        job.appearances.clear();
+        return;
+    }
+    if (!job.jpeg.empty()) {
+        static thread_local MjpegDecoder decoder;
+        TraceSpan decodeSpan(TRACE_DECODE, job.capture_ns);
+        if (!decoder.readSize(job.jpeg, job.frame_size) ||
+            !decoder.decodeScaled(job.jpeg, job.input.inputSize(), job.decoded)) {
+            // 壊れたフレームは検出なしとして扱う
+            job.peaks.assign(POSE_PARTS, std::vector<cv::Point2f>());
+            job.humans.clear();
+            job.appearances.clear();
+            return;
+        }
+        image = &job.decoded;
+    } else {
+        job.frame_size = job.frame.size();
+    }
+
+    // DNNへの入力を作成 (OpenPose MobileNet (TensorFlow) の前処理、レターボックス)
+    TraceSpan preprocessSpan(TRACE_PREPROCESS, job.capture_ns);
+    job.input.set(*image, job.frame_size);
+    preprocessSpan.end();
+
+    TraceSpan forwardSpan(TRACE_FORWARD, job.capture_ns);
+    int64_t forward_begin_ns = monotonicNowNs();
+    net.setInput(job.input.blob());
+    cv::Mat result = net.forward();
+    job.forward_ns = monotonicNowNs() - forward_begin_ns;
+    forwardSpan.end();
+
+    // 各パーツのピークを検出
+    TraceSpan peaksSpan(TRACE_PEAKS, job.capture_ns);
+    extractPeaks(result, job.input, job.peaks);
+    peaksSpan.end();
+
+    // 人間のグルーピング (簡易版: 肩のペアリング)
+    TraceSpan groupingSpan(TRACE_GROUPING, job.capture_ns);
+    groupHumans(job.peaks, job.frame_size, job.humans);
+
+    // 胴体の色はフレームを持っているワーカーで求めておく
+    job.appearances.resize(job.humans.size());
+    for (size_t i = 0; i < job.humans.size(); i++) {
+        torsoAppearance(*image, job.frame_size, job.humans[i], job.appearances[i]);
+    }
+    groupingSpan.end();
+}
+
+PoseWorkerPool::PoseWorkerPool(const std::string& modelFile, int workers, int depth)
+    : loaded(true), next_submit(0), next_result(0), in_flight(0), stopping(false) {
+    workers = std::max(1, workers);
+    depth = std::max(depth, workers);
+
+    // OpenCV の DNN はこの程度の小さいモデルではコア数に比例して速くならないので、
+    // 複数のワーカーで動かすときは 1 推論あたりのスレッド数を絞る (cv::setNumThreads はプロセス全体の設定)。
+    // supervisor からスレッド数を指定されていればそれをワーカーで分ける
+    if (workers > 1) {
+        cv::setNumThreads(std::max(1, cv::getNumThreads() / workers));
+    }
+
+    MappedFile model(modelFile);
+    if (!model.data) {
+        std::cerr << "エラー: モデルファイルを開けませんでした: " << modelFile << std::endl;
+        loaded = false;
+        return;
+    }
+
+    // 解析は Net ごとに独立しているので、ワーカーの数だけ並列に読み込む
+    nets.resize(workers);
+    std::vector<std::thread> loaders;
+    for (int i = 1; i < workers; i++) {
+        loaders.emplace_back([&, i] { nets[i] = loadPoseNet(model.data, model.size); });
+    }
+    nets[0] = loadPoseNet(model.data, model.size);
+    for (auto& t : loaders) t.join();
+    for (auto& net : nets) {
+        if (net.empty()) {
+            std::cerr << "エラー: モデルを読み込めませんでした。" << std::endl;
+            loaded = false;
+            return;
+        }
+    }
+
+    for (int i = 0; i < depth; i++) {
+        jobs.emplace_back(new PoseJob());
+        free_jobs.push_back(jobs.back().get());
+    }
+    reorder.assign(depth, nullptr);
+
+    if (workers > 1) {
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back(new Worker());
+        }
+        for (int i = 0; i < workers; i++) {
+            threads[i]->thread = std::thread(&PoseWorkerPool::workerLoop, this, i);
+        }
+    }
+}
+
+void PoseWorkerPool::warmUp(int count) {
+    std::vector<std::thread> runners;
+    for (size_t i = 1; i < nets.size(); i++) {
+        runners.emplace_back([this, i, count] { warmUpPoseNet(nets[i], count); });
+    }
+    warmUpPoseNet(nets[0], count);
+    for (auto& t : runners) t.join();
+}
+
+PoseWorkerPool::~PoseWorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    for (auto& w : threads) {
+        w->cv.notify_all();
+        w->thread.join();
+    }
+}
+
+PoseJob* PoseWorkerPool::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_jobs.empty()) return nullptr;
+    PoseJob* job = free_jobs.back();
+    free_jobs.pop_back();
+    job->done = false;
+    return job;
+}
+
+void PoseWorkerPool::submit(PoseJob* job) {
+    job->seq = next_submit++;
+    in_flight++;
+
+    if (threads.empty()) {
+        runPoseJob(nets[0], *job);
+        std::lock_guard<std::mutex> lock(mutex);
+        job->done = true;
+        reorder[job->seq % reorder.size()] = job;
+        return;
+    }
+
+    // 順番に割り振る
+    Worker& w = *threads[job->seq % threads.size()];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reorder[job->seq % reorder.size()] = job;
+        w.queue.push_back(job);
+    }
+    w.cv.notify_one();
+}
+
+PoseJob* PoseWorkerPool::next(bool wait) {
+    if (in_flight == 0) return nullptr;
+
+    // in_flight <= depth なので、次に返すジョブは必ず reorder の該当位置にある
+    std::unique_lock<std::mutex> lock(mutex);
+    PoseJob* job = reorder[next_result % reorder.size()];
+    if (wait) {
+        done_cv.wait(lock, [job] { return job->done; });
+    } else if (!job->done) {
+        return nullptr;
+    }
+
+    reorder[next_result % reorder.size()] = nullptr;
+    next_result++;
+    in_flight--;
+    return job;
+}
+
+void PoseWorkerPool::release(PoseJob* job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    free_jobs.push_back(job);
+}
+
+void PoseWorkerPool::workerLoop(int index) {
+    Worker& w = *threads[index];
+    cv::dnn::Net& net = nets[index];
+
+    while (true) {
+        PoseJob* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            w.cv.wait(lock, [&] { return stopping || !w.queue.empty(); });
+            if (stopping) return;
+            job = w.queue.front();
+            w.queue.pop_front();
+        }
+
+        runPoseJob(net, *job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->done = true;
+        }
+        done_cv.notify_all();
+    }
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "../include/vehiclepose.hpp"
+
+// 向きが 0 0 0 のときの基準の姿勢
+//   カメラ: 光軸 (z) が車両の前 (x)、画像の右 (x) が車両の右 (-y)、画像の下 (y) が下 (-z)
+//   マーカー: 表 (z) が地図の +x、右 (x) が +y、上 (y) が +z (壁に立てて +x 側から見る)
+static const Pose3 CAMERA_BASE = {{{0, 0, 1}, {-1, 0, 0}, {0, -1, 0}}, {0, 0, 0}};
+static const Pose3 MARKER_BASE = {{{0, 0, 1}, {1, 0, 0}, {0, 1, 0}}, {0, 0, 0}};
+
+// 観測の標準偏差 (距離 1 m あたり)。ArUco の姿勢は遠いほど、特に向きが不安定になる
+const double POSITION_SIGMA_PER_M = 0.02;   // [m]
+const double ANGLE_SIGMA_PER_M = 0.03;      // [rad]
+const double MIN_POSITION_SIGMA = 0.005;
+const double MIN_ANGLE_SIGMA = 0.01;
+const double OUTLIER_DISTANCE = 0.3;        // 中央値からこれ以上離れた推定は捨てる [m]
+const double OUTLIER_ANGLE = 0.35;          // [rad] (約 20 度)
+
+static double degToRad(double deg) { return deg * M_PI / 180.0; }
+
+bool loadMarkerMap(const std::string& path, MarkerMap& map) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "エラー: マーカー地図を開けませんでした: " << path << std::endl;
+        return false;
+    }
+
+    map.vehicle_to_camera = CAMERA_BASE;
+    map.markers.clear();
+    map.sizes.clear();
+
+    std::string line;
+    int lineno = 0;
+    while (std::getline(file, line)) {
+        lineno++;
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        std::string kind;
+        if (!(ss >> kind)) continue;
+
+        int id = 0;
+        double size = 0.0, x, y, z, roll, pitch, yaw;
+        bool ok;
+        if (kind == "camera") {
+            ok = (bool)(ss >> x >> y >> z >> roll >> pitch >> yaw);
+            if (ok) map.vehicle_to_camera = Pose3::fromRPY(x, y, z, degToRad(roll), degToRad(pitch), degToRad(yaw)) * CAMERA_BASE;
+        } else if (kind == "marker") {
+            ok = (bool)(ss >> id >> size >> x >> y >> z >> roll >> pitch >> yaw) && size > 0;
+            if (ok) {
+                map.markers[id] = Pose3::fromRPY(x, y, z, degToRad(roll), degToRad(pitch), degToRad(yaw)) * MARKER_BASE;
+                map.sizes[id] = size;
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "エラー: " << path << ":" << lineno << ": 解釈できない行です" << std::endl;
+            return false;
+        }
+    }
+
+    if (map.markers.empty()) {
+        std::cerr << "エラー: マーカー地図にマーカーがありません: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool vehiclePoseFromMarker(const MarkerMap& map, int id, const double rvec[3], const double tvec[3],
+                           double detected_size, MarkerPoseEstimate& estimate) {
+    auto it = map.markers.find(id);
+    if (it == map.markers.end()) return false;
+
+    // tvec は detected_size の大きさとして求めてあるので、実際の大きさに合わせる
+    double scale = map.sizes.at(id) / detected_size;
+    double t[3] = {tvec[0] * scale, tvec[1] * scale, tvec[2] * scale};
+
+    // T_world_vehicle = T_world_marker * T_camera_marker^-1 * T_vehicle_camera^-1
+    Pose3 camera_marker = Pose3::fromRvecTvec(rvec, t);
+    Pose3 world_vehicle = it->second * camera_marker.inverse() * map.vehicle_to_camera.inverse();
+
+    estimate.id = id;
+    estimate.x = world_vehicle.t[0];
+    estimate.y = world_vehicle.t[1];
+    estimate.theta = world_vehicle.yaw();
+    estimate.distance = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    return true;
+}
+
+static double median(std::vector<double>& values) {
+    size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    return values[mid];
+}
+
+int fusePoseEstimates(const std::vector<MarkerPoseEstimate>& estimates, double z[3], double covariance[9]) {
+    if (estimates.empty()) return 0;
+
+    // 外れ値を除くための基準 (中央値)。向きは中央値の周りで角度差をとる
+    std::vector<double> xs, ys, dthetas;
+    for (const auto& e : estimates) {
+        xs.push_back(e.x);
+        ys.push_back(e.y);
+    }
+    double mx = median(xs), my = median(ys);
+    double ref_theta = estimates[0].theta;
+    for (const auto& e : estimates) dthetas.push_back(wrapAngle(e.theta - ref_theta));
+    double mtheta = wrapAngle(ref_theta + median(dthetas));
+
+    // 分散の逆数で重み付けした平均
+    double wsum_pos = 0.0, wsum_ang = 0.0, sx = 0.0, sy = 0.0, stheta = 0.0;
+    int used = 0;
+    for (const auto& e : estimates) {
+        double dtheta = wrapAngle(e.theta - mtheta);
+        if (estimates.size() >= 3 &&
+            (std::hypot(e.x - mx, e.y - my) > OUTLIER_DISTANCE || std::fabs(dtheta) > OUTLIER_ANGLE)) {
+            continue;
+        }
+        double sp = std::max(MIN_POSITION_SIGMA, POSITION_SIGMA_PER_M * e.distance);
+        double sa = std::max(MIN_ANGLE_SIGMA, ANGLE_SIGMA_PER_M * e.distance);
+        double wp = 1.0 / (sp * sp), wa = 1.0 / (sa * sa);
+        sx += wp * e.x;
+        sy += wp * e.y;
+        stheta += wa * dtheta;
+        wsum_pos += wp;
+        wsum_ang += wa;
+        used++;
+    }
+    if (used == 0) return 0;
+
+    z[0] = sx / wsum_pos;
+    z[1] = sy / wsum_pos;
+    z[2] = wrapAngle(mtheta + stheta / wsum_ang);
+    for (int i = 0; i < 9; i++) covariance[i] = 0.0;
+    covariance[0] = covariance[4] = 1.0 / wsum_pos;
+    covariance[8] = 1.0 / wsum_ang;
+    return used;
+}
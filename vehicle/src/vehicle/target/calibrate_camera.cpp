@@ -0,0 +1,192 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/aruco.hpp>
+#include "../include/camera_calibration.h"
+#include "../include/perception.h"
+
+// 録画したチェスボード / ChArUco ボードの映像からカメラの内部パラメータを求め、YAML に書き出す。
+// 書き出したファイルは marker_detect / detect_humanL/R の --calib に渡す。
+//
+// Usage: calibrate_camera (--chessboard WxH | --charuco WxH --marker <m>) --square <m>
+//                         [--every N] [--headless] <video_or_camera> <output.yml>
+//   --chessboard WxH  チェスボードの内側の角の数 (例: 9x6)
+//   --charuco WxH     ChArUco ボードのマス目の数 (例: 5x7、マーカーは DICT_4X4_50)
+//   --square <m>      マス目の一辺 (メートル)
+//   --marker <m>      ChArUco のマーカーの一辺 (メートル)
+//   --every N         N フレームごとに検出する (既定 10。似た画像ばかりにならないように)
+
+const size_t MAX_VIEWS = 60;      // calibrateCamera に渡す画像の最大数
+const size_t MIN_VIEWS = 10;
+const int MIN_CHARUCO_CORNERS = 6;
+
+struct CalibrationOptions {
+    bool charuco = false;
+    cv::Size board;
+    double square = 0.0;
+    double marker = 0.0;
+    int every = 10;
+    bool headless = false;
+    std::string camera;
+    std::string output;
+};
+
+static bool parseBoardSize(const std::string& value, cv::Size& size) {
+    return sscanf(value.c_str(), "%dx%d", &size.width, &size.height) == 2 && size.width > 1 && size.height > 1;
+}
+
+static bool parseOptions(int argc, char** argv, CalibrationOptions& options) {
+    std::vector<std::string> positional;
+    bool ok = true;
+    for (int i = 1; i < argc && ok; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--chessboard" && hasValue) {
+            ok = parseBoardSize(argv[++i], options.board);
+        } else if (arg == "--charuco" && hasValue) {
+            options.charuco = true;
+            ok = parseBoardSize(argv[++i], options.board);
+        } else if (arg == "--square" && hasValue) {
+            options.square = std::atof(argv[++i]);
+        } else if (arg == "--marker" && hasValue) {
+            options.marker = std::atof(argv[++i]);
+        } else if (arg == "--every" && hasValue) {
+            options.every = std::atoi(argv[++i]);
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg.compare(0, 2, "--") != 0) {
+            positional.push_back(arg);
+        } else {
+            ok = false;
+        }
+    }
+
+    if (positional.size() == 2) {
+        options.camera = positional[0];
+        options.output = positional[1];
+    }
+    if (!ok || options.camera.empty() || options.board.width == 0 || options.square <= 0 || options.every < 1 ||
+        (options.charuco && (options.marker <= 0 || options.marker >= options.square))) {
+        std::cerr << "Usage: " << argv[0] << " (--chessboard WxH | --charuco WxH --marker <m>) --square <m>" << std::endl
+                  << "       [--every N] [--headless] <video_or_camera> <output.yml>" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 多すぎるときは均等に間引く
+template <typename T>
+static void thinOut(std::vector<T>& views) {
+    if (views.size() <= MAX_VIEWS) return;
+    std::vector<T> kept;
+    for (size_t i = 0; i < MAX_VIEWS; i++) kept.push_back(views[i * views.size() / MAX_VIEWS]);
+    views.swap(kept);
+}
+
+int main(int argc, char** argv) {
+    CalibrationOptions options;
+    if (!parseOptions(argc, argv, options)) return -1;
+
+    cv::VideoCapture cap;
+    if (!openCamera(cap, options.camera)) return -1;
+
+    // チェスボードの角の3次元座標 (ボード平面 z = 0)
+    std::vector<cv::Point3f> boardPoints;
+    for (int y = 0; y < options.board.height; y++) {
+        for (int x = 0; x < options.board.width; x++) {
+            boardPoints.push_back(cv::Point3f(x * options.square, y * options.square, 0));
+        }
+    }
+
+    cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_50);
+    cv::Ptr<cv::aruco::CharucoBoard> charucoBoard;
+    if (options.charuco) {
+        charucoBoard = cv::aruco::CharucoBoard::create(options.board.width, options.board.height,
+                                                       options.square, options.marker, dictionary);
+    }
+
+    std::vector<std::vector<cv::Point2f>> imagePoints;   // 検出した角 (画像ごと)
+    std::vector<std::vector<int>> charucoIds;
+    cv::Size imageSize;
+
+    if (!options.headless) {
+        cv::namedWindow("Calibration", cv::WINDOW_NORMAL);
+        cv::resizeWindow("Calibration", 640, 480);
+    }
+
+    cv::Mat frame, gray;
+    int64_t capture_ns;
+    for (int n = 0; grabFrame(cap, frame, capture_ns); n++) {
+        imageSize = frame.size();
+        if (n % options.every != 0) continue;
+
+        cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+        bool found = false;
+
+        if (options.charuco) {
+            std::vector<int> markerIds, ids;
+            std::vector<std::vector<cv::Point2f>> markerCorners;
+            std::vector<cv::Point2f> corners;
+            cv::aruco::detectMarkers(gray, dictionary, markerCorners, markerIds);
+            if (!markerIds.empty()) {
+                cv::aruco::interpolateCornersCharuco(markerCorners, markerIds, gray, charucoBoard, corners, ids);
+            }
+            if ((int)ids.size() >= MIN_CHARUCO_CORNERS) {
+                imagePoints.push_back(corners);
+                charucoIds.push_back(ids);
+                found = true;
+                if (!options.headless) cv::aruco::drawDetectedCornersCharuco(frame, corners, ids);
+            }
+        } else {
+            std::vector<cv::Point2f> corners;
+            if (cv::findChessboardCorners(gray, options.board, corners,
+                                          cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE | cv::CALIB_CB_FAST_CHECK)) {
+                cv::cornerSubPix(gray, corners, cv::Size(11, 11), cv::Size(-1, -1),
+                                 cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 30, 0.01));
+                imagePoints.push_back(corners);
+                found = true;
+                if (!options.headless) cv::drawChessboardCorners(frame, options.board, corners, true);
+            }
+        }
+
+        if (found) std::cout << "検出: フレーム " << n << " (" << imagePoints.size() << " 枚目)" << std::endl;
+
+        if (!options.headless) {
+            cv::imshow("Calibration", frame);
+            if (cv::waitKey(1) == 'q') break;
+        }
+    }
+    cap.release();
+    if (!options.headless) cv::destroyAllWindows();
+
+    if (imagePoints.size() < MIN_VIEWS) {
+        std::cerr << "エラー: ボードを検出できた画像が少なすぎます (" << imagePoints.size() << " 枚、" << MIN_VIEWS << " 枚以上必要)。" << std::endl;
+        return -1;
+    }
+    thinOut(imagePoints);
+    thinOut(charucoIds);
+
+    std::cout << imagePoints.size() << " 枚の画像でキャリブレーションします..." << std::endl;
+    CameraIntrinsics intrinsics;
+    intrinsics.image_size = imageSize;
+    std::vector<cv::Mat> rvecs, tvecs;
+    double rms;
+    if (options.charuco) {
+        rms = cv::aruco::calibrateCameraCharuco(imagePoints, charucoIds, charucoBoard, imageSize,
+                                                intrinsics.camera_matrix, intrinsics.dist_coeffs, rvecs, tvecs);
+    } else {
+        std::vector<std::vector<cv::Point3f>> objectPoints(imagePoints.size(), boardPoints);
+        rms = cv::calibrateCamera(objectPoints, imagePoints, imageSize,
+                                  intrinsics.camera_matrix, intrinsics.dist_coeffs, rvecs, tvecs);
+    }
+
+    std::cout << "再投影誤差 (RMS): " << rms << " px" << std::endl;
+    if (rms > 1.0) {
+        std::cerr << "警告: 再投影誤差が大きいです。ボードの写り方 (距離・角度) を変えて撮り直してください。" << std::endl;
+    }
+
+    if (!saveIntrinsics(options.output, intrinsics, rms)) return -1;
+    std::cout << "保存しました: " << options.output << std::endl;
+    return 0;
+}
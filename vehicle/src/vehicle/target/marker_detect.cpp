@@ -1,136 +1,174 @@
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <opencv2/aruco.hpp>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <string.h>
-#include <ctime>
-#include "../include/shm_data.h"
+#include "../include/camera_calibration.h"
+#include "../include/change_detector.h"
+#include "../include/marker_pose.h"
+#include "../include/perception.h"
+#include "../include/trace.h"
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <camera_path_or_id>" << std::endl;
-        return -1;
-    }
-
-    // カメラデバイスのパスまたはIDを取得
-    std::string camera_path;
-    int camera_id = 0;
-    bool use_camera_id = false;
-
-    std::string arg = argv[1];
-    if (std::all_of(arg.begin(), arg.end(), ::isdigit)) {
-        camera_id = std::stoi(arg);
-        use_camera_id = true;
-    } else {
-        camera_path = arg;
-        use_camera_id = false;
-    }
+    StartupTimer startup;
+    PerceptionOptions options;
+    if (!parsePerceptionOptions(argc, argv, options)) return -1;
+    applyThreadBudget();
+    installStopHandler();
 
     // 共有メモリの初期化
-    const char* shm_name = "/aruco_data";
-    int shm_fd = shm_open(shm_name, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) {
-        std::cerr << "エラー: 共有メモリを作成できませんでした。" << std::endl;
-        return -1;
-    }
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(true, shm_fd);
+    if (!shared_data) return -1;
 
-    // 共有メモリのサイズを設定
-    if (ftruncate(shm_fd, sizeof(SharedMemoryData)) == -1) {
-        std::cerr << "エラー: 共有メモリのサイズを設定できませんでした。" << std::endl;
-        close(shm_fd);
-        return -1;
-    }
-
-    // 共有メモリをマッピング
-    SharedMemoryData* shared_data = reinterpret_cast<SharedMemoryData*>(mmap(nullptr, sizeof(SharedMemoryData), 
-                                                            PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0));
-    if (shared_data == MAP_FAILED) {
-        std::cerr << "エラー: 共有メモリをマッピングできませんでした。" << std::endl;
-        close(shm_fd);
-        return -1;
-    }
+    // 共有メモリの初期化 (ゼロクリア) と削除は supervisor が行う
 
-    // 共有メモリデータを初期化 (注意: 別のプロセスが既に動いている場合は初期化しない方が良いかもしれないが、ここでは簡易的に)
-    // memset(shared_data, 0, sizeof(SharedMemoryData)); 
-    // 既存のデータを消さないように、必要な部分だけ更新するか、起動時に一度だけクリアするロジックが必要。
-    // 今回はとりあえずそのままにします。
+    TraceRecorder::instance().open("marker_detect");
 
     // Webカメラを開く
     cv::VideoCapture cap;
-    if (use_camera_id) {
-        cap.open(camera_id, cv::CAP_V4L2);
-    } else {
-        cap.open(camera_path, cv::CAP_V4L2);
+    if (!openCamera(cap, options.camera)) {
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
     }
+    startup.phase("camera");
 
-    if (!cap.isOpened()) {
-        std::cerr << "エラー: カメラを開けませんでした。" << std::endl;
-        munmap(shared_data, sizeof(SharedMemoryData));
-        close(shm_fd);
-        return -1;
+    // --luma: YUYV のまま受け取り、輝度 (Y) だけを取り出して検出する。
+    // BGR への変換 (バックエンド) とグレーへの変換 (detectMarkers の中) の2回を省く
+    bool luma = options.luma && enableRawYuyv(cap);
+    if (options.luma && !luma) {
+        std::cerr << "警告: YUYV をそのまま取得できないので、通常の取得に戻します。" << std::endl;
     }
+    cv::Size lumaSize((int)cap.get(cv::CAP_PROP_FRAME_WIDTH), (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT));
 
     // ArUcoマーカーの辞書とパラメータを準備
     cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_50);
     cv::Ptr<cv::aruco::DetectorParameters> detectorParams = cv::aruco::DetectorParameters::create();
 
-    // カメラの内部パラメータ（キャリブレーションで得られる値）
-    double fx = 600.0, fy = 600.0;
-    double cx = 320.0, cy = 240.0;
-    cv::Mat cameraMatrix = (cv::Mat_<double>(3, 3) << fx, 0, cx, 0, fy, cy, 0, 0, 1);
-    cv::Mat distCoeffs = cv::Mat::zeros(5, 1, CV_64F); // 歪み係数（今回はゼロと仮定）
+    // カメラの内部パラメータ（calibrate_camera で得られる値）
+    CameraIntrinsics intrinsics = defaultIntrinsics();
+    if (!options.calibration.empty()) {
+        if (!loadIntrinsics(options.calibration, intrinsics)) {
+            closeSharedMemory(shared_data, shm_fd);
+            return -1;
+        }
+    } else {
+        std::cerr << "警告: --calib が指定されていないので、既定の内部パラメータ (fx = fy = 600、歪みなし) を使います。" << std::endl;
+    }
 
     // ウィンドウサイズを小さく設定
-    cv::namedWindow("AR Marker Detection", cv::WINDOW_NORMAL);
-    cv::resizeWindow("AR Marker Detection", 320, 240);
+    if (!options.headless) {
+        cv::namedWindow("AR Marker Detection", cv::WINDOW_NORMAL);
+        cv::resizeWindow("AR Marker Detection", 320, 240);
+    }
 
-    while (true) {
-        cv::Mat frame;
-        cap >> frame;
-        if (frame.empty()) break;
+    registerProducer(shared_data, PRODUCER_MARKER);
+    ProducerMetrics& metrics = shared_data->metrics.producers[PRODUCER_MARKER];
+    FrameDropCounter drops(cap.get(cv::CAP_PROP_FPS));
+
+    // フレームをまたいで使い回すバッファ
+    cv::Mat captured, yuyv, gray, frame;
+
+    // 前回の結果 (--gate でシーンが変わっていなければそのまま書き直す)
+    ChangeDetector gate;
+    std::vector<int> markerIds;
+    std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
+    std::vector<cv::Vec3d> rvecs, tvecs; // 回転ベクトルと平行移動ベクトル
+    MarkerPoseEstimator poseEstimator(MARKER_LENGTH);
+    std::vector<int> order;              // 共有メモリに書き込む順番 (溢れるときは近い順)
+    MarkerFrame markerFrame;             // 共有メモリに書き込む内容 (seqlock で丸ごと書き込む)
+
+    while (!stopRequested()) {
+        int64_t capture_ns;
+        if (!grabFrame(cap, captured, capture_ns)) break;
+        double capture_timestamp = capture_ns * 1e-9;
+        metrics.dropped.fetch_add(drops.update(capture_ns), std::memory_order_relaxed);
+
+        // 検出に使う画像 (--luma なら Y だけの CV_8UC1、そうでなければ取得した BGR)
+        cv::Mat image = captured;
+        if (luma) {
+            if (!wrapYuyv(captured, lumaSize, yuyv)) {
+                std::cerr << "エラー: YUYV のフレームの大きさが合いません。" << std::endl;
+                break;
+            }
+            cv::extractChannel(yuyv, gray, 0);
+            image = gray;
+        }
+        fitIntrinsics(intrinsics, image.size());
+
+        // マーカーを検出 (前に検出したフレームから変わっていなければ省く)
+        bool reused = options.gate && !gate.update(image, monotonicNow());
+        if (reused) {
+            metrics.reused.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            TraceSpan detectSpan(TRACE_DETECT, capture_ns);
+            int64_t detect_begin_ns = monotonicNowNs();
+            cv::aruco::detectMarkers(image, dictionary, markerCorners, markerIds, detectorParams, rejectedCandidates);
+            metrics.inference.record(monotonicNowNs() - detect_begin_ns);
+        }
 
-        // マーカーを検出
-        std::vector<int> markerIds;
-        std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
-        
-        cv::aruco::detectMarkers(frame, dictionary, markerCorners, markerIds, detectorParams, rejectedCandidates);
+        // 表示用の BGR。--luma のときは表示するときだけ色変換する
+        if (!options.headless) {
+            if (luma) {
+                cv::cvtColor(yuyv, frame, cv::COLOR_YUV2BGR_YUYV);
+            } else {
+                frame = captured;
+            }
+        }
 
         // 検出されたマーカーがあれば処理
         if (!markerIds.empty()) {
-            // 検出したマーカーの輪郭を描画
-            cv::aruco::drawDetectedMarkers(frame, markerCorners, markerIds);
-
-            // 各マーカーの姿勢を推定
-            std::vector<cv::Vec3d> rvecs, tvecs; // 回転ベクトルと平行移動ベクトル
-            // 第2引数はマーカーの実際のサイズ(メートル単位)
-            cv::aruco::estimatePoseSingleMarkers(markerCorners, 0.05, cameraMatrix, distCoeffs, rvecs, tvecs);
+            if (!reused) {
+                // 検出したマーカーの輪郭を描画 (歪み補正で角を書き換える前に)
+                if (!options.headless) cv::aruco::drawDetectedMarkers(frame, markerCorners, markerIds);
+
+                // 各マーカーの姿勢を推定 (マーカーごとに並列。前のフレームの姿勢があればそこから合わせ込む)
+                // フレーム全体ではなく、検出した角だけを歪み補正してから推定する (歪み係数はゼロで渡す)
+                TraceSpan poseSpan(TRACE_POSE, capture_ns);
+                for (auto& corners : markerCorners) undistortPixels(intrinsics, corners);
+                poseEstimator.estimate(markerCorners, markerIds, intrinsics.camera_matrix, capture_timestamp, rvecs, tvecs);
+                poseSpan.end();
+
+                // 書ききれないときは近いマーカーを優先する
+                order.resize(markerIds.size());
+                std::iota(order.begin(), order.end(), 0);
+                if ((int)order.size() > MAX_MARKERS) {
+                    std::partial_sort(order.begin(), order.begin() + MAX_MARKERS, order.end(),
+                                      [&](int a, int b) { return cv::norm(tvecs[a]) < cv::norm(tvecs[b]); });
+                    order.resize(MAX_MARKERS);
+                }
+            }
 
             // 共有メモリにマーカーデータを書き込み
-            shared_data->marker_count = markerIds.size();
-            
-            // Use wall clock time for timestamp
-            auto now = std::chrono::system_clock::now();
-            double timestamp = std::chrono::duration<double>(now.time_since_epoch()).count();
-            shared_data->last_marker_update_time = timestamp;
-            
-            for (size_t i = 0; i < markerIds.size() && i < 10; ++i) {
-                shared_data->markers[i].id = markerIds[i];
-                shared_data->markers[i].tvec[0] = tvecs[i][0];
-                shared_data->markers[i].tvec[1] = tvecs[i][1];
-                shared_data->markers[i].tvec[2] = tvecs[i][2];
-                shared_data->markers[i].rvec[0] = rvecs[i][0];
-                shared_data->markers[i].rvec[1] = rvecs[i][1];
-                shared_data->markers[i].rvec[2] = rvecs[i][2];
-                shared_data->markers[i].timestamp = shared_data->last_marker_update_time;
+            TraceSpan publishSpan(TRACE_PUBLISH, capture_ns);
+
+            // NTPで飛ばないように monotonic clock を使う
+            double timestamp = monotonicNow();
+            for (size_t k = 0; k < order.size(); ++k) {
+                int i = order[k];
+                ArUcoMarkerData& marker = markerFrame.markers[k];
+                marker.id = markerIds[i];
+                marker.tvec[0] = tvecs[i][0];
+                marker.tvec[1] = tvecs[i][1];
+                marker.tvec[2] = tvecs[i][2];
+                marker.rvec[0] = rvecs[i][0];
+                marker.rvec[1] = rvecs[i][1];
+                marker.rvec[2] = rvecs[i][2];
+                marker.timestamp = timestamp;
+                marker.capture_timestamp = capture_timestamp;
+                marker.reused = reused;
             }
+            markerFrame.count = (int)order.size();
+            markerFrame.update_time = timestamp;
+            markerFrame.capture_time = capture_timestamp;
+            shared_data->marker_frame.write(markerFrame);
+            publishSpan.end();
 
             // 推定した姿勢（座標軸）を描画
             for (size_t i = 0; i < markerIds.size(); ++i) {
-                cv::drawFrameAxes(frame, cameraMatrix, distCoeffs, rvecs[i], tvecs[i], 0.1);
+                // 表示するのは歪んだままのフレームなので、歪み係数を入れて投影する
+                if (!options.headless) cv::drawFrameAxes(frame, intrinsics.camera_matrix, intrinsics.dist_coeffs, rvecs[i], tvecs[i], 0.1);
                 
                 // IDと位置情報を表示（コンソールと共有メモリ両方に出力）
                 std::cout << "ID: " << markerIds[i] 
@@ -139,29 +177,37 @@ int main(int argc, char** argv) {
             }
         } else {
             // マーカーが検出されなかった場合
-            shared_data->marker_count = 0;
-            auto now = std::chrono::system_clock::now();
-            shared_data->last_marker_update_time = std::chrono::duration<double>(now.time_since_epoch()).count();
+            TraceSpan publishSpan(TRACE_PUBLISH, capture_ns);
+            markerFrame.count = 0;
+            markerFrame.update_time = monotonicNow();
+            markerFrame.capture_time = capture_timestamp;
+            shared_data->marker_frame.write(markerFrame);
+        }
+
+        metrics.latency.record(monotonicNowNs() - capture_ns);
+        metrics.frames.fetch_add(1, std::memory_order_relaxed);
+        heartbeat(shared_data, PRODUCER_MARKER);
+        if (!shared_data->pipeline.producers[PRODUCER_MARKER].ready) {
+            startup.phase("first_frame");
+            markReady(shared_data, PRODUCER_MARKER, startup);
         }
 
         // 結果を表示
-        cv::imshow("AR Marker Detection", frame);
+        if (!options.headless) {
+            cv::imshow("AR Marker Detection", frame);
 
-        // 'q'キーが押されたらループを抜ける
-        if (cv::waitKey(1) == 'q') {
-            break;
+            // 'q'キーが押されたらループを抜ける
+            if (cv::waitKey(1) == 'q') {
+                break;
+            }
         }
     }
 
     cap.release();
-    cv::destroyAllWindows();
+    if (!options.headless) cv::destroyAllWindows();
 
     // 共有メモリのクリーンアップ
-    munmap(shared_data, sizeof(SharedMemoryData));
-    close(shm_fd);
-    // shm_unlink(shm_name); // 共有メモリセグメントを削除
-    // NOTE: shm_unlink is not called here to avoid removing the shared memory segment
-    // while other processes might still be using it. Cleanup should be handled separately.
+    closeSharedMemory(shared_data, shm_fd);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/perception.h"
+#include "../include/perf_counters.h"
+#include "../include/trace.h"
+
+// 動いているパイプラインの統計 (共有メモリの metrics) を読み出し専用で表示する。
+// interval 秒あけて2回読み、その差からレートとパーセンタイルを求める。
+//
+// Usage: pipeline_stat [--json] [--interval <s>] [--perf]
+//   --json      1回だけ JSON で出力して終了する
+//   --interval  読み出しの間隔 (既定 1 秒)
+//   --perf      VEHICLE_PERF で動いているプロセスのハードウェアカウンタも表示する (JSON では無視)
+
+struct HistogramSnapshot {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[LATENCY_BUCKETS];
+};
+
+struct ProducerSnapshot {
+    uint64_t frames;
+    uint64_t dropped;
+    uint64_t reused;
+    int queue_depth;
+    HistogramSnapshot latency;
+    HistogramSnapshot inference;
+};
+
+static HistogramSnapshot readHistogram(const LatencyHistogram& h) {
+    HistogramSnapshot s;
+    s.count = h.count.load(std::memory_order_relaxed);
+    s.sum_us = h.sum_us.load(std::memory_order_relaxed);
+    s.max_us = h.max_us.load(std::memory_order_relaxed);
+    for (int i = 0; i < LATENCY_BUCKETS; i++) s.buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+    return s;
+}
+
+static ProducerSnapshot readProducer(const SharedMemoryData* shared_data, int id) {
+    const ProducerMetrics& m = shared_data->metrics.producers[id];
+    ProducerSnapshot s;
+    s.frames = m.frames.load(std::memory_order_relaxed);
+    s.dropped = m.dropped.load(std::memory_order_relaxed);
+    s.reused = m.reused.load(std::memory_order_relaxed);
+    s.queue_depth = m.queue_depth.load(std::memory_order_relaxed);
+    if (id == PRODUCER_SERIAL_MUX) {
+        const SerialCommandQueue& queue = shared_data->serial_commands;
+        s.queue_depth = (int)(queue.enqueue_pos.load(std::memory_order_relaxed) - queue.dequeue_pos.load(std::memory_order_relaxed));
+    }
+    s.latency = readHistogram(m.latency);
+    s.inference = readHistogram(m.inference);
+    return s;
+}
+
+// 区間の中は一様に分布しているとして補間する (観測した最大値を超えないようにする) [ms]。データが無ければ負の値
+static double percentileMs(const HistogramSnapshot& before, const HistogramSnapshot& after, double q) {
+    uint64_t count = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) count += after.buckets[i] - before.buckets[i];
+    if (count == 0) return -1.0;
+
+    double target = q * count;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        uint64_t n = after.buckets[i] - before.buckets[i];
+        if (n > 0 && cumulative + n >= target) {
+            double lower = latencyBucketLower(i), upper = latencyBucketLower(i + 1);
+            double us = lower + (upper - lower) * (target - cumulative) / n;
+            return std::min(us, (double)after.max_us) / 1000.0;
+        }
+        cumulative += n;
+    }
+    return after.max_us / 1000.0;
+}
+
+// 最後にデータが書き込まれてからの時間の元になる時刻 (フレームの取得時刻など)。無ければ 0
+static double dataTime(const SharedMemoryData* shared_data, int id) {
+    switch (id) {
+    case PRODUCER_MARKER: {
+        MarkerFrame frame;
+        return shared_data->marker_frame.read(frame) ? frame.capture_time : 0.0;
+    }
+    case PRODUCER_HUMAN_L: return shared_data->last_human_capture_time_L;
+    case PRODUCER_HUMAN_R: return shared_data->last_human_capture_time_R;
+    case PRODUCER_SERIAL_MUX: return shared_data->vehicle_status.battery_update_time;
+    case PRODUCER_VEHICLE_POSE: {
+        VehiclePose pose;
+        return shared_data->vehicle_pose.read(pose) && pose.valid ? pose.measurement_time : 0.0;
+    }
+    default: return 0.0;
+    }
+}
+
+struct ProducerReport {
+    std::string name;
+    int pid;
+    bool alive;
+    double startup_ms;      // 起動から ready までの時間 (まだ ready でなければ負)
+    double heartbeat_age;   // [s] (未登録なら負)
+    double rate;            // [1/s]
+    double drop_rate;
+    double reused_ratio;    // 処理を省いたフレームの割合 (--gate。フレームが無ければ負)
+    uint64_t frames, dropped;
+    int queue_depth;
+    double latency[4];      // p50, p90, p99, max [ms]
+    double inference[4];
+    double data_age;        // [s] (データが無ければ負)
+};
+
+static void histogramReport(const HistogramSnapshot& before, const HistogramSnapshot& after, double out[4]) {
+    out[0] = percentileMs(before, after, 0.50);
+    out[1] = percentileMs(before, after, 0.90);
+    out[2] = percentileMs(before, after, 0.99);
+    out[3] = after.count > 0 ? after.max_us / 1000.0 : -1.0;
+}
+
+static std::vector<ProducerReport> collect(const SharedMemoryData* shared_data, double interval) {
+    ProducerSnapshot before[PRODUCER_COUNT], after[PRODUCER_COUNT];
+    for (int id = 0; id < PRODUCER_COUNT; id++) before[id] = readProducer(shared_data, id);
+    double begin = monotonicNow();
+    usleep((useconds_t)(interval * 1e6));
+    for (int id = 0; id < PRODUCER_COUNT; id++) after[id] = readProducer(shared_data, id);
+    double now = monotonicNow();
+    double elapsed = now - begin;
+
+    std::vector<ProducerReport> reports;
+    for (int id = 0; id < PRODUCER_COUNT; id++) {
+        const ProducerStatus& status = shared_data->pipeline.producers[id];
+        ProducerReport r;
+        r.name = producerName((ProducerId)id);
+        r.pid = status.pid;
+        r.alive = status.pid > 0 && kill(status.pid, 0) == 0;
+        r.startup_ms = status.pid > 0 && status.ready ? status.startup_ms : -1.0;
+        r.heartbeat_age = status.pid > 0 ? now - status.heartbeat : -1.0;
+        r.frames = after[id].frames;
+        r.dropped = after[id].dropped;
+        r.rate = (after[id].frames - before[id].frames) / elapsed;
+        r.drop_rate = (after[id].dropped - before[id].dropped) / elapsed;
+        uint64_t frames = after[id].frames - before[id].frames;
+        r.reused_ratio = frames > 0 ? (double)(after[id].reused - before[id].reused) / frames : -1.0;
+        r.queue_depth = after[id].queue_depth;
+        histogramReport(before[id].latency, after[id].latency, r.latency);
+        histogramReport(before[id].inference, after[id].inference, r.inference);
+        double t = dataTime(shared_data, id);
+        r.data_age = t > 0 ? now - t : -1.0;
+        reports.push_back(r);
+    }
+    return reports;
+}
+
+// 負の値 (データなし) は "-"
+static std::string cell(double value, int precision) {
+    if (value < 0) return "-";
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(precision) << value;
+    return ss.str();
+}
+
+static void printTable(const std::vector<ProducerReport>& reports) {
+    std::cout << std::left << std::setw(14) << "producer" << std::right
+              << std::setw(8) << "pid" << std::setw(9) << "ready" << std::setw(9) << "hb[ms]" << std::setw(8) << "rate"
+              << std::setw(10) << "dropped" << std::setw(7) << "drop/s" << std::setw(6) << "skip%" << std::setw(6) << "queue"
+              << std::setw(24) << "latency p50/p90/p99" << std::setw(9) << "max"
+              << std::setw(17) << "infer p50/p99" << std::setw(10) << "age[ms]" << std::endl;
+    for (const auto& r : reports) {
+        std::string pid = r.pid == 0 ? "-" : std::to_string(r.pid) + (r.alive ? "" : "!");
+        std::string latency = cell(r.latency[0], 1) + "/" + cell(r.latency[1], 1) + "/" + cell(r.latency[2], 1);
+        std::string inference = cell(r.inference[0], 1) + "/" + cell(r.inference[2], 1);
+        std::cout << std::left << std::setw(14) << r.name << std::right
+                  << std::setw(8) << pid << std::setw(9) << cell(r.startup_ms, 0) << std::setw(9) << cell(r.heartbeat_age * 1000.0, 0)
+                  << std::setw(8) << cell(r.rate, 1) << std::setw(10) << r.dropped << std::setw(7) << cell(r.drop_rate, 1)
+                  << std::setw(6) << cell(r.reused_ratio * 100.0, 0)
+                  << std::setw(6) << r.queue_depth << std::setw(24) << latency << std::setw(9) << cell(r.latency[3], 1)
+                  << std::setw(17) << inference << std::setw(10) << cell(r.data_age * 1000.0, 0) << std::endl;
+    }
+    std::cout << "(時間は ms。ready は起動にかかった時間、- はまだ準備中。pid の ! はプロセスが存在しない)" << std::endl;
+}
+
+// データなし (負の値) は null
+static std::string json(double value) {
+    if (value < 0) return "null";
+    std::ostringstream ss;
+    ss << std::setprecision(6) << value;
+    return ss.str();
+}
+
+static void printJson(const std::vector<ProducerReport>& reports, double interval) {
+    auto histogram = [](const double h[4]) {
+        return "{\"p50\": " + json(h[0]) + ", \"p90\": " + json(h[1]) + ", \"p99\": " + json(h[2]) + ", \"max\": " + json(h[3]) + "}";
+    };
+    std::cout << "{\"interval\": " << interval << ", \"producers\": [";
+    for (size_t i = 0; i < reports.size(); i++) {
+        const ProducerReport& r = reports[i];
+        std::cout << (i ? ", " : "") << std::endl
+                  << "  {\"name\": \"" << r.name << "\", \"pid\": " << r.pid << ", \"alive\": " << (r.alive ? "true" : "false")
+                  << ", \"ready\": " << (r.startup_ms >= 0 ? "true" : "false") << ", \"startup_ms\": " << json(r.startup_ms)
+                  << ", \"heartbeat_age_ms\": " << json(r.heartbeat_age * 1000.0)
+                  << ", \"rate\": " << json(r.rate) << ", \"frames\": " << r.frames
+                  << ", \"dropped\": " << r.dropped << ", \"drop_rate\": " << json(r.drop_rate)
+                  << ", \"reused_ratio\": " << json(r.reused_ratio)
+                  << ", \"queue_depth\": " << r.queue_depth
+                  << ", \"latency_ms\": " << histogram(r.latency) << ", \"inference_ms\": " << histogram(r.inference)
+                  << ", \"data_age_ms\": " << json(r.data_age * 1000.0) << "}";
+    }
+    std::cout << std::endl << "]}" << std::endl;
+}
+
+// /dev/shm/vehicle_perf_* を全部表示する
+static void printPerfBlocks() {
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return;
+    const char* prefix = PERF_SHM_PREFIX + 1; // 先頭の '/' を除く
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, prefix, strlen(prefix)) != 0) continue;
+        int fd = shm_open((std::string("/") + entry->d_name).c_str(), O_RDONLY, 0);
+        if (fd == -1) continue;
+        void* p = mmap(nullptr, sizeof(PerfBlock), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) continue;
+        const PerfBlock* block = static_cast<const PerfBlock*>(p);
+        if (block->magic == PERF_MAGIC) {
+            std::cout << std::endl << "---- perf counters (" << block->process << ", pid " << block->pid << ") ----" << std::endl;
+            printPerfSummary(*block, std::cout);
+        }
+        munmap(p, sizeof(PerfBlock));
+    }
+    closedir(dir);
+}
+
+int main(int argc, char** argv) {
+    bool json_once = false, perf = false;
+    double interval = 1.0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") {
+            json_once = true;
+        } else if (arg == "--perf") {
+            perf = true;
+        } else if (arg == "--interval" && i + 1 < argc) {
+            interval = std::atof(argv[++i]);
+        } else {
+            interval = 0;
+        }
+    }
+    if (interval <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [--json] [--interval <s>] [--perf]" << std::endl;
+        return -1;
+    }
+
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(false, shm_fd);
+    if (!shared_data) return -1;
+
+    if (json_once) {
+        printJson(collect(shared_data, interval), interval);
+    } else {
+        while (true) {
+            std::vector<ProducerReport> reports = collect(shared_data, interval);
+            std::cout << "\033[2J\033[1;1H"; // 画面クリアとカーソル移動
+            printTable(reports);
+            if (perf) printPerfBlocks();
+            std::cout << std::flush;
+        }
+    }
+
+    closeSharedMemory(shared_data, shm_fd);
+    return 0;
+}
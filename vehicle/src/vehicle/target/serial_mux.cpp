@@ -0,0 +1,363 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include "../include/perception.h"
+#include "../include/trace.h"
+
+// モーター基板とバッテリー基板のシリアルをまとめて扱うデーモン。
+// すべてのTTYをノンブロッキングで開き epoll で待つ。
+// - 受信した行をボードごとに解析して共有メモリの vehicle_status に書き込む
+// - バッテリー基板には "r<hz>;" で電圧を送り続けるように頼む。送ってこなければ (開いた直後やリセット後) 頼み直す
+// - クライアントは TTY を直接開かず、共有メモリの serial_commands に積む。
+//   積まれたら futex で起こされる (待ち受け用のスレッドが eventfd に変えて epoll に渡す) ので、定期的に見に行かない
+//
+// Usage: serial_mux --motor <tty> --battery <tty> [--battery-hz <rate>]
+
+const int TICK_MS = 100;          // ハートビートの周期 (コマンドは積まれたときに転送する)
+const int REOPEN_INTERVAL_MS = 1000;
+const int BATTERY_MISSED_FRAMES = 3; // この周期分バッテリーの行が来なければ送るように頼み直す
+
+struct SerialPort {
+    SerialDevice device;
+    std::string path;
+    int fd = -1;
+    std::string rx;   // まだ改行が来ていない受信データ
+    std::string tx;   // まだ書き込めていない送信データ
+    bool watching_out = false;
+};
+
+static int openSerial(const std::string& path) {
+    int fd = open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd == -1) return -1;
+
+    termios tio;
+    if (tcgetattr(fd, &tio) == -1) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1; // O_NONBLOCK と合わせてデータがなければ EAGAIN
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void closePort(int epfd, SerialPort& port) {
+    if (port.fd == -1) return;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, port.fd, nullptr);
+    close(port.fd);
+    port.fd = -1;
+    port.rx.clear();
+    port.tx.clear();
+    port.watching_out = false;
+    std::cerr << "切断: " << port.path << std::endl;
+}
+
+static void tryOpenPort(int epfd, SerialPort& port, int index) {
+    if (port.fd != -1 || port.path.empty()) return;
+    port.fd = openSerial(port.path);
+    if (port.fd == -1) return;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = index;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, port.fd, &ev);
+    std::cout << "接続: " << port.path << std::endl;
+}
+
+static void watchWritable(int epfd, SerialPort& port, int index, bool enable) {
+    if (port.watching_out == enable) return;
+    epoll_event ev{};
+    ev.events = enable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u32 = index;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, port.fd, &ev);
+    port.watching_out = enable;
+}
+
+// 書けるだけ書き、残りは EPOLLOUT を待つ
+static void flushPort(int epfd, SerialPort& port, int index) {
+    while (!port.tx.empty()) {
+        ssize_t n = write(port.fd, port.tx.data(), port.tx.size());
+        if (n > 0) {
+            port.tx.erase(0, n);
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == -1 && errno == EAGAIN) {
+            break;
+        } else {
+            closePort(epfd, port);
+            return;
+        }
+    }
+    watchWritable(epfd, port, index, !port.tx.empty());
+}
+
+static void sendToPort(int epfd, SerialPort& port, int index, const char* data, size_t len) {
+    if (port.fd == -1) return;
+    port.tx.append(data, len);
+    flushPort(epfd, port, index);
+}
+
+// battery.ino: 送り続けるときは "v:<ms>:<mV>:<%>"、's' で問い合わせたときは "b:<mV>::"
+static void handleBatteryLine(const std::string& line, VehicleStatusData& status) {
+    unsigned long board_ms;
+    int level, percent;
+    if (sscanf(line.c_str(), "v:%lu:%d:%d", &board_ms, &level, &percent) == 3) {
+        status.battery_level = level;
+        status.battery_percent = percent;
+        status.battery_update_time = monotonicNow();
+    } else if (sscanf(line.c_str(), "b:%d::", &level) == 1) {
+        status.battery_level = level;
+        status.battery_update_time = monotonicNow();
+    }
+}
+
+// motor.ino: move() ごとに "<vR>,<vL>"、それ以外はデバッグ出力
+static void handleMotorLine(const std::string& line, VehicleStatusData& status) {
+    float vR, vL;
+    if (sscanf(line.c_str(), "%f,%f", &vR, &vL) == 2) {
+        status.motor_vR = vR;
+        status.motor_vL = vL;
+    }
+    status.motor_ack_count++;
+    strncpy(status.motor_last_line, line.c_str(), sizeof(status.motor_last_line) - 1);
+    status.motor_last_line[sizeof(status.motor_last_line) - 1] = '\0';
+    status.motor_update_time = monotonicNow();
+}
+
+// 受信データを行に区切って解析する (行は途中で分割されて届くことがある)
+static void readPort(int epfd, SerialPort& port, VehicleStatusData& status) {
+    char buf[256];
+    while (true) {
+        ssize_t n = read(port.fd, buf, sizeof(buf));
+        if (n > 0) {
+            port.rx.append(buf, n);
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n == 0 || errno == EAGAIN) {
+            break; // TTY では 0 は EOF ではなく「データなし」
+        } else {
+            closePort(epfd, port);
+            return;
+        }
+    }
+
+    size_t start = 0, end;
+    while ((end = port.rx.find('\n', start)) != std::string::npos) {
+        std::string line = port.rx.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) {
+            if (port.device == SERIAL_BATTERY) {
+                handleBatteryLine(line, status);
+            } else {
+                handleMotorLine(line, status);
+            }
+        }
+        start = end + 1;
+    }
+    port.rx.erase(0, start);
+    if (port.rx.size() > 1024) port.rx.clear(); // 改行が来ないゴミは捨てる
+}
+
+static int makeTimer(int interval_ms) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) return -1;
+    itimerspec spec{};
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, nullptr);
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    StartupTimer startup;
+    SerialPort ports[SERIAL_DEVICE_COUNT];
+    ports[SERIAL_MOTOR].device = SERIAL_MOTOR;
+    ports[SERIAL_BATTERY].device = SERIAL_BATTERY;
+    double battery_hz = 2.0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--motor") {
+            ports[SERIAL_MOTOR].path = argv[i + 1];
+        } else if (opt == "--battery") {
+            ports[SERIAL_BATTERY].path = argv[i + 1];
+        } else if (opt == "--battery-hz") {
+            battery_hz = std::stod(argv[i + 1]);
+        } else {
+            argc = 0; // 不明なオプション
+        }
+    }
+    if (argc == 0 || (ports[SERIAL_MOTOR].path.empty() && ports[SERIAL_BATTERY].path.empty()) || battery_hz <= 0) {
+        std::cerr << "Usage: " << argv[0] << " --motor <tty> --battery <tty> [--battery-hz <rate>]" << std::endl;
+        return -1;
+    }
+
+    // 共有メモリの初期化
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(true, shm_fd);
+    if (!shared_data) return -1;
+
+    VehicleStatusData& status = shared_data->vehicle_status;
+    memset(&status, 0, sizeof(status));
+    shared_data->serial_commands.init();
+    registerProducer(shared_data, PRODUCER_SERIAL_MUX);
+    ProducerMetrics& metrics = shared_data->metrics.producers[PRODUCER_SERIAL_MUX];
+
+    // SIGINT/SIGTERM も epoll で受け取る
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int tick_fd = makeTimer(TICK_MS);
+    int battery_fd = makeTimer(std::max(1, (int)(1000.0 / battery_hz)));
+    int command_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd == -1 || tick_fd == -1 || battery_fd == -1 || sig_fd == -1 || command_fd == -1) {
+        std::cerr << "エラー: epoll/timerfd/signalfd/eventfd を作成できませんでした。" << std::endl;
+        closeSharedMemory(shared_data, shm_fd);
+        return -1;
+    }
+
+    // data.u32: 0..SERIAL_DEVICE_COUNT-1 はシリアル、それ以降は下の ID
+    const uint32_t ID_TICK = SERIAL_DEVICE_COUNT, ID_BATTERY = SERIAL_DEVICE_COUNT + 1, ID_SIGNAL = SERIAL_DEVICE_COUNT + 2,
+                   ID_COMMAND = SERIAL_DEVICE_COUNT + 3;
+    const std::pair<int, uint32_t> fixed_fds[] = {
+        {tick_fd, ID_TICK}, {battery_fd, ID_BATTERY}, {sig_fd, ID_SIGNAL}, {command_fd, ID_COMMAND}};
+    for (const auto& f : fixed_fds) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = f.second;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, f.first, &ev);
+    }
+
+    for (int i = 0; i < SERIAL_DEVICE_COUNT; i++) {
+        tryOpenPort(epfd, ports[i], i);
+        if (!ports[i].path.empty() && ports[i].fd == -1) {
+            std::cerr << "警告: " << ports[i].path << " を開けませんでした。再接続を試みます。" << std::endl;
+        }
+    }
+    // ポートが開けなくてもコマンドは受け付ける (開けたら送る)
+    startup.phase("ports");
+    markReady(shared_data, PRODUCER_SERIAL_MUX, startup);
+
+    // キューに積まれるまで futex で眠り、積まれたら eventfd で epoll のループを起こす
+    // (シグナルはブロックしてから作るので、このスレッドには届かない)
+    SerialCommandQueue& queue = shared_data->serial_commands;
+    std::atomic<bool> waiter_running{true};
+    std::thread waiter([&]() {
+        uint32_t seen = 0; // init() 直後の値
+        while (waiter_running.load(std::memory_order_relaxed)) {
+            uint32_t now = queue.waitForPush(seen);
+            if (now == seen) continue;
+            seen = now;
+            uint64_t one = 1;
+            if (write(command_fd, &one, sizeof(one)) == -1 && errno != EAGAIN) break;
+        }
+    });
+
+    // クライアントからのコマンドを転送
+    auto forwardCommands = [&]() {
+        SerialDevice device;
+        char data[sizeof(SerialCommand::data)];
+        size_t len;
+        uint64_t forwarded = 0;
+        while (queue.pop(device, data, len)) {
+            if (device < SERIAL_DEVICE_COUNT) sendToPort(epfd, ports[device], device, data, len);
+            forwarded++;
+        }
+        metrics.frames.fetch_add(forwarded, std::memory_order_relaxed);
+    };
+
+    int ticks_since_reopen = 0;
+    bool running = true;
+    epoll_event events[8];
+
+    while (running) {
+        int n = epoll_wait(epfd, events, 8, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int k = 0; k < n; k++) {
+            uint32_t id = events[k].data.u32;
+
+            if (id < SERIAL_DEVICE_COUNT) {
+                SerialPort& port = ports[id];
+                if (port.fd == -1) continue;
+                if (events[k].events & (EPOLLERR | EPOLLHUP)) {
+                    closePort(epfd, port);
+                    continue;
+                }
+                if (events[k].events & EPOLLIN) readPort(epfd, port, status);
+                if (port.fd != -1 && (events[k].events & EPOLLOUT)) flushPort(epfd, port, id);
+            } else if (id == ID_TICK) {
+                uint64_t expirations;
+                if (read(tick_fd, &expirations, sizeof(expirations)) <= 0) continue;
+
+                // 通知より前に積まれていたもの (起動直後など) もここで拾う
+                forwardCommands();
+
+                status.serial_mux_heartbeat = monotonicNow();
+                heartbeat(shared_data, PRODUCER_SERIAL_MUX);
+
+                ticks_since_reopen += expirations;
+                if (ticks_since_reopen * TICK_MS >= REOPEN_INTERVAL_MS) {
+                    ticks_since_reopen = 0;
+                    for (int i = 0; i < SERIAL_DEVICE_COUNT; i++) tryOpenPort(epfd, ports[i], i);
+                }
+            } else if (id == ID_BATTERY) {
+                uint64_t expirations;
+                if (read(battery_fd, &expirations, sizeof(expirations)) <= 0) continue;
+                if (monotonicNow() - status.battery_update_time > BATTERY_MISSED_FRAMES / battery_hz) {
+                    std::string request = "r" + std::to_string(std::max(1, (int)(battery_hz + 0.5))) + ";";
+                    sendToPort(epfd, ports[SERIAL_BATTERY], SERIAL_BATTERY, request.data(), request.size());
+                }
+            } else if (id == ID_COMMAND) {
+                uint64_t count;
+                if (read(command_fd, &count, sizeof(count)) <= 0) continue;
+                forwardCommands();
+            } else if (id == ID_SIGNAL) {
+                running = false;
+            }
+        }
+    }
+
+    std::cout << "serial_mux を終了します。" << std::endl;
+    queue.ready.store(0, std::memory_order_release);
+    waiter_running.store(false, std::memory_order_relaxed);
+    queue.wake();
+    waiter.join();
+    for (auto& port : ports) closePort(epfd, port);
+    close(tick_fd);
+    close(command_fd);
+    close(battery_fd);
+    close(sig_fd);
+    close(epfd);
+
+    closeSharedMemory(shared_data, shm_fd);
+    return 0;
+}
@@ -1,39 +1,32 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <chrono>
 #include <iomanip>
-#include "../include/shm_data.h"
+#include "../include/perception.h"
+#include "../include/trace.h"
 
 int main() {
     // 共有メモリの初期化
-    const char* shm_name = "/aruco_data";
-    int shm_fd = shm_open(shm_name, O_RDWR, 0666);
-    if (shm_fd == -1) {
-        std::cerr << "エラー: 共有メモリを開けませんでした。detect_humanL/R または marker_detect を先に実行してください。" << std::endl;
-        return -1;
-    }
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(false, shm_fd);
+    if (!shared_data) return -1;
+    applyThreadBudget();
 
-    SharedMemoryData* shared_data = reinterpret_cast<SharedMemoryData*>(mmap(nullptr, sizeof(SharedMemoryData), 
-                                                            PROT_READ, MAP_SHARED, shm_fd, 0));
-    if (shared_data == MAP_FAILED) {
-        std::cerr << "エラー: 共有メモリをマッピングできませんでした。" << std::endl;
-        close(shm_fd);
-        return -1;
-    }
+    TraceRecorder::instance().open("state_viewer");
 
     cv::namedWindow("State Viewer", cv::WINDOW_NORMAL);
     cv::resizeWindow("State Viewer", 640, 480);
 
+    // 前回読んだ更新時刻 (新しいフレームを読んだときだけ consume を記録する)
+    double seen_update_time_L = 0.0, seen_update_time_R = 0.0, seen_marker_update_time = 0.0;
+    MarkerFrame markerFrame;   // marker_frame から読み出したもの
+
     while (true) {
+        int64_t consume_begin_ns = monotonicNowNs();
+
         // 白い背景
         cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(255, 255, 255));
 
-        auto now = std::chrono::system_clock::now();
-        double current_time = std::chrono::duration<double>(now.time_since_epoch()).count();
+        double current_time = monotonicNow();
         double timeout = 1.0; // 1秒以上更新がなければ検出なしとみなす
 
         // Camera L (Blue)
@@ -100,11 +93,36 @@ int main() {
             std::cout << "R : not found" << std::endl;
         }
 
+        // 車両の姿勢 (vehicle_pose)
+        VehiclePose pose;
+        if (shared_data->vehicle_pose.read(pose) && pose.valid && current_time - pose.measurement_time < timeout) {
+            std::cout << "Pose : (" << std::fixed << std::setprecision(2) << pose.x << "," << pose.y << ") "
+                      << std::setprecision(1) << pose.theta * 180.0 / M_PI << "deg"
+                      << " (markers: " << pose.markers_used << ")" << std::endl;
+        } else {
+            std::cout << "Pose : not found" << std::endl;
+        }
+
+        // 各プロデューサの新しいフレームについて、取得時刻から読み終わるまでを記録
+        int64_t consume_end_ns = monotonicNowNs();
+        TraceRecorder& recorder = TraceRecorder::instance();
+        if (shared_data->last_human_update_time_L != seen_update_time_L) {
+            seen_update_time_L = shared_data->last_human_update_time_L;
+            recorder.record(TRACE_CONSUME, consume_begin_ns, consume_end_ns, (int64_t)(shared_data->last_human_capture_time_L * 1e9));
+        }
+        if (shared_data->last_human_update_time_R != seen_update_time_R) {
+            seen_update_time_R = shared_data->last_human_update_time_R;
+            recorder.record(TRACE_CONSUME, consume_begin_ns, consume_end_ns, (int64_t)(shared_data->last_human_capture_time_R * 1e9));
+        }
+        if (shared_data->marker_frame.read(markerFrame) && markerFrame.update_time != seen_marker_update_time) {
+            seen_marker_update_time = markerFrame.update_time;
+            recorder.record(TRACE_CONSUME, consume_begin_ns, consume_end_ns, (int64_t)(markerFrame.capture_time * 1e9));
+        }
+
         cv::imshow("State Viewer", frame);
         if (cv::waitKey(30) == 'q') break;
     }
 
-    munmap(shared_data, sizeof(SharedMemoryData));
-    close(shm_fd);
+    closeSharedMemory(shared_data, shm_fd);
     return 0;
 }
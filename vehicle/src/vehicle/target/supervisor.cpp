@@ -0,0 +1,433 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "../include/perception.h"
+#include "../include/trace.h"
+
+// 検出プログラムをまとめて起動・監視するプロセス。
+// - 共有メモリ (/aruco_data) を作成・ゼロクリアし、終了時に削除する
+// - 設定ファイルのステージごとに CPU アフィニティ、OpenCV のスレッド数、優先度を決めて起動する
+// - 落ちたステージ、ハートビートが止まったステージを再起動する
+//
+// Usage: supervisor <config>   (例: vehicle/config/pipeline.conf)
+
+const int CHECK_INTERVAL_MS = 100;
+const double MAX_RESTART_DELAY = 30.0;
+const double STABLE_RUN_TIME = 10.0;   // これより長く動いていたら再起動の待ち時間を戻す
+const double STOP_TIMEOUT = 3.0;       // SIGTERM を送ってから SIGKILL までの時間
+
+struct Stage {
+    std::string name;
+    std::vector<std::string> command;
+    std::vector<int> cpus;          // 空なら制限しない
+    int threads = 0;                // cv::setNumThreads (0 なら OpenCV の既定)
+    int nice = 0;
+    int realtime = 0;               // SCHED_FIFO の優先度 (0 なら通常のスケジューリング)
+    int producer = -1;              // ハートビートを見る ProducerId (-1 なら終了だけ監視する)
+    double timeout = 3.0;           // ハートビートが止まってから再起動するまでの時間
+    double startup_timeout = 60.0;  // 起動から最初のハートビートまで (モデルの読み込みなど)
+
+    pid_t pid = 0;
+    double started = 0.0;
+    double restart_at = 0.0;        // pid == 0 のとき、この時刻に起動する
+    double restart_delay = 1.0;
+    unsigned int restarts = 0;
+    bool ready = false;             // ready になったことを表示したか
+};
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+// "0,2-3" -> {0, 2, 3}
+static bool parseCpus(const std::string& value, std::vector<int>& cpus) {
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        item = trim(item);
+        int first, last;
+        char dash;
+        std::stringstream range(item);
+        if (!(range >> first)) return false;
+        last = first;
+        if (range >> dash && (dash != '-' || !(range >> last))) return false;
+        for (int c = first; c <= last; c++) cpus.push_back(c);
+    }
+    return !cpus.empty();
+}
+
+// [name] のセクションと key = value の行。# 以降はコメント
+static bool loadConfig(const std::string& path, std::vector<Stage>& stages) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "エラー: 設定ファイルを開けませんでした: " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineno = 0;
+    while (std::getline(file, line)) {
+        lineno++;
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+
+        if (line.front() == '[' && line.back() == ']') {
+            stages.emplace_back();
+            stages.back().name = line.substr(1, line.size() - 2);
+            continue;
+        }
+
+        size_t eq = line.find('=');
+        if (stages.empty() || eq == std::string::npos) {
+            std::cerr << "エラー: " << path << ":" << lineno << ": 解釈できない行です" << std::endl;
+            return false;
+        }
+        Stage& stage = stages.back();
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+
+        bool ok = true;
+        try {
+            if (key == "command") {
+                std::stringstream ss(value);
+                std::string arg;
+                while (ss >> arg) stage.command.push_back(arg);
+            } else if (key == "cpus") {
+                ok = parseCpus(value, stage.cpus);
+            } else if (key == "threads") {
+                stage.threads = std::stoi(value);
+            } else if (key == "nice") {
+                stage.nice = std::stoi(value);
+            } else if (key == "realtime") {
+                stage.realtime = std::stoi(value);
+            } else if (key == "heartbeat") {
+                ok = false;
+                for (int id = 0; id < PRODUCER_COUNT; id++) {
+                    if (value == producerName((ProducerId)id)) {
+                        stage.producer = id;
+                        ok = true;
+                    }
+                }
+            } else if (key == "timeout") {
+                stage.timeout = std::stod(value);
+            } else if (key == "startup_timeout") {
+                stage.startup_timeout = std::stod(value);
+            } else {
+                ok = false;
+            }
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "エラー: " << path << ":" << lineno << ": " << key << " の値が不正です" << std::endl;
+            return false;
+        }
+    }
+
+    for (const auto& stage : stages) {
+        if (stage.command.empty()) {
+            std::cerr << "エラー: [" << stage.name << "] に command がありません" << std::endl;
+            return false;
+        }
+    }
+    if (stages.empty()) {
+        std::cerr << "エラー: ステージがありません: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// 前回の実行のトレース (/vehicle_trace_*) と perf カウンタ (/vehicle_perf_*) を消す。
+// 各プロセスは終了後も trace_merge / pipeline_stat --perf で読めるように、自分では消さない
+static void removeStaleSegments(const char* prefix) {
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return;
+    const char* name = prefix + 1; // 先頭の '/' を除く
+    while (dirent* entry = readdir(dir)) {
+        if (strncmp(entry->d_name, name, strlen(name)) == 0) shm_unlink((std::string("/") + entry->d_name).c_str());
+    }
+    closedir(dir);
+}
+
+// 共有メモリを作り直してゼロクリアする (前回の残りがあれば消す)
+static SharedMemoryData* createSharedMemory(int& shm_fd) {
+    if (shm_unlink(SHM_NAME) == 0) {
+        std::cerr << "警告: 前回の共有メモリが残っていたので削除しました。" << std::endl;
+    }
+    shm_fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (shm_fd == -1) {
+        std::cerr << "エラー: 共有メモリを作成できませんでした。" << std::endl;
+        return nullptr;
+    }
+    if (ftruncate(shm_fd, sizeof(SharedMemoryData)) == -1) {
+        std::cerr << "エラー: 共有メモリのサイズを設定できませんでした。" << std::endl;
+        close(shm_fd);
+        shm_unlink(SHM_NAME);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, sizeof(SharedMemoryData), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    if (p == MAP_FAILED) {
+        std::cerr << "エラー: 共有メモリをマッピングできませんでした。" << std::endl;
+        close(shm_fd);
+        shm_unlink(SHM_NAME);
+        return nullptr;
+    }
+
+    SharedMemoryData* shared_data = static_cast<SharedMemoryData*>(p);
+    memset(static_cast<void*>(shared_data), 0, sizeof(SharedMemoryData));
+    shared_data->pipeline.supervisor_pid = getpid();
+    return shared_data;
+}
+
+// fork した子プロセスの中で呼ぶ。戻らない
+static void execStage(const Stage& stage) {
+    // supervisor が死んだら一緒に終わる
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    // supervisor は signalfd のためにシグナルをブロックしているので戻す
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+    if (!stage.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : stage.cpus) CPU_SET(c, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+            std::cerr << "警告: [" << stage.name << "] CPU アフィニティを設定できませんでした: " << strerror(errno) << std::endl;
+        }
+    }
+
+    if (stage.threads > 0) {
+        std::string threads = std::to_string(stage.threads);
+        setenv("VEHICLE_CV_THREADS", threads.c_str(), 1);
+        setenv("OMP_NUM_THREADS", threads.c_str(), 1);
+    }
+
+    if (stage.realtime > 0) {
+        sched_param param{};
+        param.sched_priority = stage.realtime;
+        if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+            std::cerr << "警告: [" << stage.name << "] SCHED_FIFO を設定できませんでした: " << strerror(errno) << std::endl;
+        }
+    } else if (stage.nice != 0 && setpriority(PRIO_PROCESS, 0, stage.nice) == -1) {
+        std::cerr << "警告: [" << stage.name << "] nice を設定できませんでした: " << strerror(errno) << std::endl;
+    }
+
+    std::vector<char*> argv;
+    for (const auto& arg : stage.command) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    execvp(argv[0], argv.data());
+
+    std::cerr << "エラー: [" << stage.name << "] " << stage.command[0] << " を起動できませんでした: " << strerror(errno) << std::endl;
+    _exit(127);
+}
+
+static void startStage(Stage& stage, SharedMemoryData* shared_data) {
+    // 前のプロセスのハートビートを消しておく
+    if (stage.producer >= 0) {
+        ProducerStatus& status = shared_data->pipeline.producers[stage.producer];
+        status.pid = 0;
+        status.heartbeat = 0.0;
+        status.ready = false;
+    }
+    stage.ready = false;
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "エラー: [" << stage.name << "] fork に失敗しました: " << strerror(errno) << std::endl;
+        stage.restart_at = monotonicNow() + stage.restart_delay;
+        return;
+    }
+    if (pid == 0) execStage(stage);
+
+    stage.pid = pid;
+    stage.started = monotonicNow();
+    std::cout << "起動: [" << stage.name << "] pid " << pid << std::endl;
+}
+
+// 終了したプロセスを回収し、再起動の時刻を決める
+static void reapStages(std::vector<Stage>& stages, SharedMemoryData* shared_data) {
+    int wstatus;
+    pid_t pid;
+    while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+        for (auto& stage : stages) {
+            if (stage.pid != pid) continue;
+
+            double now = monotonicNow();
+            if (WIFSIGNALED(wstatus)) {
+                std::cerr << "終了: [" << stage.name << "] シグナル " << WTERMSIG(wstatus) << std::endl;
+            } else {
+                std::cerr << "終了: [" << stage.name << "] 終了コード " << WEXITSTATUS(wstatus) << std::endl;
+            }
+            if (stage.producer >= 0) shared_data->pipeline.producers[stage.producer].pid = 0;
+
+            // すぐに落ち続けるなら待ち時間を倍にしていく
+            if (now - stage.started >= STABLE_RUN_TIME) stage.restart_delay = 1.0;
+            stage.pid = 0;
+            stage.restart_at = now + stage.restart_delay;
+            stage.restart_delay = std::min(MAX_RESTART_DELAY, stage.restart_delay * 2);
+            stage.restarts++;
+        }
+    }
+}
+
+// ハートビートが止まったステージを SIGKILL する (回収後に再起動される)
+static void checkHeartbeats(std::vector<Stage>& stages, const SharedMemoryData* shared_data) {
+    double now = monotonicNow();
+    for (auto& stage : stages) {
+        if (stage.pid == 0 || stage.producer < 0) continue;
+
+        const ProducerStatus& status = shared_data->pipeline.producers[stage.producer];
+        bool registered = (status.pid == stage.pid);
+        if (registered && status.ready && !stage.ready) {
+            stage.ready = true;
+            std::cout << "準備完了: [" << stage.name << "] " << status.startup_ms << " ms" << std::endl;
+        }
+        double age = registered ? now - status.heartbeat : now - stage.started;
+        double limit = registered ? stage.timeout : stage.startup_timeout;
+        if (age > limit) {
+            std::cerr << "応答なし: [" << stage.name << "] " << age << " 秒間ハートビートがありません" << std::endl;
+            kill(stage.pid, SIGKILL);
+        }
+    }
+}
+
+static void stopStages(std::vector<Stage>& stages) {
+    for (auto& stage : stages) {
+        if (stage.pid > 0) kill(stage.pid, SIGTERM);
+    }
+
+    double deadline = monotonicNow() + STOP_TIMEOUT;
+    while (true) {
+        bool alive = false;
+        for (auto& stage : stages) {
+            if (stage.pid > 0 && waitpid(stage.pid, nullptr, WNOHANG) == stage.pid) stage.pid = 0;
+            if (stage.pid > 0) alive = true;
+        }
+        if (!alive) return;
+        if (monotonicNow() > deadline) break;
+        usleep(CHECK_INTERVAL_MS * 1000);
+    }
+
+    for (auto& stage : stages) {
+        if (stage.pid > 0) {
+            std::cerr << "強制終了: [" << stage.name << "]" << std::endl;
+            kill(stage.pid, SIGKILL);
+            waitpid(stage.pid, nullptr, 0);
+            stage.pid = 0;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <config>" << std::endl;
+        return -1;
+    }
+
+    std::vector<Stage> stages;
+    if (!loadConfig(argv[1], stages)) return -1;
+
+    // SIGCHLD/SIGINT/SIGTERM は epoll で受け取る (子プロセスでは execStage で戻す)
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    int sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epfd == -1 || timer_fd == -1 || sig_fd == -1) {
+        std::cerr << "エラー: epoll/timerfd/signalfd を作成できませんでした。" << std::endl;
+        return -1;
+    }
+    itimerspec spec{};
+    spec.it_interval.tv_nsec = CHECK_INTERVAL_MS * 1000000L;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+
+    const int fds[] = {sig_fd, timer_fd};
+    for (int fd : fds) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    int shm_fd;
+    SharedMemoryData* shared_data = createSharedMemory(shm_fd);
+    if (!shared_data) return -1;
+    removeStaleSegments(TRACE_SHM_PREFIX);
+    removeStaleSegments(PERF_SHM_PREFIX);
+
+    for (auto& stage : stages) startStage(stage, shared_data);
+
+    bool running = true;
+    epoll_event events[4];
+    while (running) {
+        int n = epoll_wait(epfd, events, 4, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int k = 0; k < n; k++) {
+            if (events[k].data.fd == sig_fd) {
+                signalfd_siginfo info;
+                while (read(sig_fd, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo != SIGCHLD) running = false;
+                }
+                reapStages(stages, shared_data);
+            } else if (events[k].data.fd == timer_fd) {
+                uint64_t expirations;
+                if (read(timer_fd, &expirations, sizeof(expirations)) <= 0) continue;
+
+                checkHeartbeats(stages, shared_data);
+
+                double now = monotonicNow();
+                for (auto& stage : stages) {
+                    if (stage.pid == 0 && now >= stage.restart_at) {
+                        std::cout << "再起動: [" << stage.name << "] (" << stage.restarts << " 回目)" << std::endl;
+                        startStage(stage, shared_data);
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "supervisor を終了します。" << std::endl;
+    stopStages(stages);
+
+    close(timer_fd);
+    close(sig_fd);
+    close(epfd);
+
+    // 共有メモリを作ったのは supervisor なので、ここで削除する
+    munmap(shared_data, sizeof(SharedMemoryData));
+    close(shm_fd);
+    shm_unlink(SHM_NAME);
+    return 0;
+}
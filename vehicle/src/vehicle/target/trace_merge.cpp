@@ -0,0 +1,142 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iomanip>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include "../include/trace.h"
+
+// 各プロセスのトレース用リングバッファ (/dev/shm/vehicle_trace_*) を読み出し、
+// chrome://tracing や Perfetto で開ける trace-event JSON にまとめる。
+//
+// Usage: trace_merge [output.json] [--unlink]
+
+struct MergedEvent {
+    std::string process;
+    int pid;
+    uint32_t tid;
+    uint32_t stage;
+    int64_t begin_ns;
+    int64_t end_ns;
+    int64_t capture_ns;
+};
+
+// 書き込み中のスロットを読まないよう seq を前後で確認してコピーする
+static void readRing(const TraceRing* ring, std::vector<MergedEvent>& out) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+    for (uint64_t n = first; n < head; n++) {
+        const TraceEvent& e = ring->events[n & (TRACE_RING_SIZE - 1)];
+        uint64_t seq1 = e.seq.load(std::memory_order_acquire);
+        if (seq1 != n * 2 + 2) continue; // 上書き済み、または書き込み中
+
+        MergedEvent m;
+        m.process = ring->process;
+        m.pid = ring->pid;
+        m.tid = e.tid;
+        m.stage = e.stage;
+        m.begin_ns = e.begin_ns;
+        m.end_ns = e.end_ns;
+        m.capture_ns = e.capture_ns;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (e.seq.load(std::memory_order_relaxed) != seq1) continue;
+        out.push_back(m);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string output = "trace.json";
+    bool unlink_after = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--unlink") {
+            unlink_after = true;
+        } else {
+            output = arg;
+        }
+    }
+
+    // TRACE_SHM_PREFIX の先頭の '/' を除いたものが /dev/shm 上のファイル名
+    std::string prefix = TRACE_SHM_PREFIX + 1;
+    std::vector<std::string> segments;
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) {
+        std::cerr << "エラー: /dev/shm を開けませんでした。" << std::endl;
+        return -1;
+    }
+    while (dirent* ent = readdir(dir)) {
+        if (strncmp(ent->d_name, prefix.c_str(), prefix.size()) == 0) {
+            segments.push_back(std::string("/") + ent->d_name);
+        }
+    }
+    closedir(dir);
+
+    if (segments.empty()) {
+        std::cerr << "エラー: トレースが見つかりません。VEHICLE_TRACE=1 を付けて各プロセスを実行してください。" << std::endl;
+        return -1;
+    }
+
+    std::vector<MergedEvent> events;
+    for (const auto& name : segments) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0666);
+        if (fd == -1) continue;
+        void* p = mmap(nullptr, sizeof(TraceRing), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) continue;
+
+        const TraceRing* ring = static_cast<const TraceRing*>(p);
+        if (ring->magic == TRACE_MAGIC) {
+            size_t before = events.size();
+            readRing(ring, events);
+            std::cout << name << " (" << ring->process << ", pid " << ring->pid << "): "
+                      << events.size() - before << " events" << std::endl;
+        }
+        munmap(p, sizeof(TraceRing));
+        if (unlink_after) shm_unlink(name.c_str());
+    }
+
+    std::sort(events.begin(), events.end(), [](const MergedEvent& a, const MergedEvent& b) {
+        return a.begin_ns < b.begin_ns;
+    });
+
+    std::ofstream out(output);
+    if (!out) {
+        std::cerr << "エラー: " << output << " に書き込めませんでした。" << std::endl;
+        return -1;
+    }
+
+    // ts/dur はマイクロ秒。latency_ms はフレーム取得からこの段が終わるまでの時間
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    std::vector<int> named_pids;
+    bool first = true;
+    for (const auto& e : events) {
+        if (std::find(named_pids.begin(), named_pids.end(), e.pid) == named_pids.end()) {
+            named_pids.push_back(e.pid);
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << e.pid
+                << ",\"args\":{\"name\":\"" << e.process << "\"}}";
+            first = false;
+        }
+        out << ",\n{\"name\":\"" << traceStageName(e.stage) << "\",\"cat\":\"" << e.process
+            << "\",\"ph\":\"X\",\"pid\":" << e.pid << ",\"tid\":" << e.tid
+            << ",\"ts\":" << e.begin_ns / 1000.0 << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1000.0;
+        if (e.capture_ns != 0) {
+            out << ",\"args\":{\"capture_us\":" << e.capture_ns / 1000.0
+                << ",\"latency_ms\":" << (e.end_ns - e.capture_ns) / 1e6 << "}";
+        }
+        out << "}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    std::cout << events.size() << " events -> " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <time.h>
+#include <errno.h>
+#include "../include/perception.h"
+#include "../include/trace.h"
+#include "../include/vehiclepose.hpp"
+
+// marker_detect の結果 (カメラ座標のマーカー) から車両の姿勢を推定し、共有メモリの vehicle_pose に書き込む。
+// - 見えているマーカーごとに車両の姿勢を求め、外れ値を除いて1つにまとめる
+// - まとめた観測を EKF (等速度モデル) に入れる
+// - カメラより速い一定周期で、現在時刻まで外挿した姿勢を書き込む
+//
+// Usage: vehicle_pose --map <marker_map> [--rate <hz>]
+
+int main(int argc, char** argv) {
+    StartupTimer startup;
+    std::string map_path;
+    double rate = 200.0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--map") {
+            map_path = argv[i + 1];
+        } else if (opt == "--rate") {
+            rate = std::atof(argv[i + 1]);
+        } else {
+            argc = 0; // 不明なオプション
+        }
+    }
+    if (argc == 0 || map_path.empty() || rate <= 0) {
+        std::cerr << "Usage: " << argv[0] << " --map <marker_map> [--rate <hz>]" << std::endl;
+        return -1;
+    }
+
+    MarkerMap map;
+    if (!loadMarkerMap(map_path, map)) return -1;
+    std::cout << "マーカー地図: " << map.markers.size() << " 個" << std::endl;
+
+    // 共有メモリの初期化
+    int shm_fd;
+    SharedMemoryData* shared_data = openSharedMemory(true, shm_fd);
+    if (!shared_data) return -1;
+    applyThreadBudget();
+    installStopHandler();
+
+    TraceRecorder::instance().open("vehicle_pose");
+    registerProducer(shared_data, PRODUCER_VEHICLE_POSE);
+    startup.phase("map");
+    ProducerMetrics& metrics = shared_data->metrics.producers[PRODUCER_VEHICLE_POSE];
+
+    const int64_t period_ns = (int64_t)(1e9 / rate);
+
+    VehiclePoseEKF ekf;
+    std::vector<MarkerPoseEstimate> estimates;
+    MarkerFrame frame;   // marker_frame を seqlock で丸ごとコピーしたもの (書き込み途中のマーカーは読まない)
+    double seen_capture_time = 0.0;
+    int markers_used = 0;
+
+    timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!stopRequested()) {
+        // 新しいフレームのマーカーがあれば観測として取り込む
+        if (shared_data->marker_frame.read(frame) && frame.capture_time != seen_capture_time) {
+            double capture_time = frame.capture_time;
+            seen_capture_time = capture_time;
+            int64_t capture_ns = (int64_t)(capture_time * 1e9);
+            TraceSpan fuseSpan(TRACE_FUSE, capture_ns);
+            int64_t fuse_begin_ns = monotonicNowNs();
+
+            estimates.clear();
+            int count = std::min(frame.count, MAX_MARKERS);
+            for (int i = 0; i < count; i++) {
+                const ArUcoMarkerData& marker = frame.markers[i];
+                // --gate で検出を省いたフレームは前回と同じ観測なので、新しい観測として EKF に入れない
+                if (marker.reused) continue;
+                MarkerPoseEstimate estimate;
+                if (vehiclePoseFromMarker(map, marker.id, marker.rvec, marker.tvec, MARKER_LENGTH, estimate)) {
+                    estimates.push_back(estimate);
+                }
+            }
+
+            double z[3], R[9];
+            int used = fusePoseEstimates(estimates, z, R);
+            if (used > 0 && ekf.update(capture_time, z, R)) markers_used = used;
+            metrics.inference.record(monotonicNowNs() - fuse_begin_ns);
+            metrics.latency.record(monotonicNowNs() - capture_ns);
+            metrics.frames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // 現在時刻まで外挿して書き込む
+        VehiclePose pose;
+        ekf.poseAt(monotonicNow(), pose);
+        pose.markers_used = markers_used;
+        shared_data->vehicle_pose.write(pose);
+        heartbeat(shared_data, PRODUCER_VEHICLE_POSE);
+        if (!shared_data->pipeline.producers[PRODUCER_VEHICLE_POSE].ready) markReady(shared_data, PRODUCER_VEHICLE_POSE, startup);
+
+        // 一定周期で回す (遅れたら追いつこうとせずに次の周期から)
+        int64_t next_ns = next.tv_sec * 1000000000LL + next.tv_nsec + period_ns;
+        int64_t now_ns = monotonicNowNs();
+        if (next_ns < now_ns) next_ns = now_ns;
+        next.tv_sec = next_ns / 1000000000LL;
+        next.tv_nsec = next_ns % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR && !stopRequested()) {}
+    }
+
+    closeSharedMemory(shared_data, shm_fd);
+    return 0;
+}